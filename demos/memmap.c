@@ -7,6 +7,8 @@ int is_present(size_t entry) {
   return entry & (1ull << PTEDIT_PAGE_BIT_PRESENT);
 #elif defined(__aarch64__)
   return (entry & 3) == 3;
+#elif defined(__riscv)
+  return entry & (1ull << PTEDIT_PAGE_BIT_PRESENT);
 #endif
 }
 
@@ -15,10 +17,13 @@ int is_normal_page(size_t entry) {
   return !(entry & (1ull << PTEDIT_PAGE_BIT_PSE));
 #elif defined(__aarch64__)
   return 1;
+#elif defined(__riscv)
+  /* Leaf entries have at least one of R, W, X set */
+  return !(entry & ((1ull << PTEDIT_PAGE_BIT_READ) | (1ull << PTEDIT_PAGE_BIT_RW) | (1ull << PTEDIT_PAGE_BIT_EXEC)));
 #endif
 }
 
-#if defined(__i386__) || defined(__x86_64__)
+#if defined(__i386__) || defined(__x86_64__) || defined(__riscv)
 #define FIRST_LEVEL_ENTRIES 256 // only 256, because upper half is kernel
 #elif defined(__aarch64__)
 #define FIRST_LEVEL_ENTRIES 512
@@ -45,6 +50,14 @@ int main(int argc, char *argv[]) {
     pid = atoi(argv[1]);
   }
 
+#if defined(__riscv)
+  /* The walk below is the 4-level one (Sv48) */
+  if (!ptedit_paging_definition.has_pud || ptedit_paging_definition.has_p4d) {
+    printf("Error: Only Sv48 is supported (boot the kernel with no5lvl)\n");
+    return 1;
+  }
+#endif
+
   printf("Dumping PID %zd\n", pid);
 
   size_t root = ptedit_get_paging_root(pid);
@@ -64,7 +77,7 @@ int main(int argc, char *argv[]) {
       continue;
     dump(dump_entry, pml4_entry, "");
 
-#if defined(__i386__) || defined(__x86_64__)
+#if defined(__i386__) || defined(__x86_64__) || defined(__riscv)
     /* Iterate through PDPT entries */
     ptedit_read_physical_page(ptedit_get_pfn(pml4_entry), (char *)pdpt);
     for (pdpti = 0; pdpti < 512; pdpti++) {
@@ -93,7 +106,7 @@ int main(int argc, char *argv[]) {
             if (!is_present(pt_entry))
               continue;
             dump(dump_entry, pt_entry, "        PT  ");
-#if defined(__i386__) || defined(__x86_64__)
+#if defined(__i386__) || defined(__x86_64__) || defined(__riscv)
             printf("            -> %zx\n", ((size_t)pti << 12) | ((size_t)pdi << 21) | ((size_t)pdpti << 30) | ((size_t)pml4i << 39));
 #elif defined(__aarch64__)
             printf("            -> %zx\n", ((size_t)pti << 12) | ((size_t)pdi << 21) | ((size_t)pml4i << 30));
@@ -106,7 +119,7 @@ int main(int argc, char *argv[]) {
           mem_usage += 2 * 1024 * 1024;
         }
       }
-#if defined(__i386__) || defined(__x86_64__)
+#if defined(__i386__) || defined(__x86_64__) || defined(__riscv)
     }
 #endif
   }
@@ -35,6 +35,15 @@ void nx_function() {
 #define NX_BIT PTEDIT_PAGE_BIT_XN
 #endif
 
+#if defined(__riscv)
+/* RISC-V has an execute-permission bit instead of an NX bit */
+#define is_nx(address, pid) (!ptedit_pte_get_bit(address, pid, PTEDIT_PAGE_BIT_EXEC))
+#define clear_nx(address, pid) ptedit_pte_set_bit(address, pid, PTEDIT_PAGE_BIT_EXEC)
+#else
+#define is_nx(address, pid) ptedit_pte_get_bit(address, pid, NX_BIT)
+#define clear_nx(address, pid) ptedit_pte_clear_bit(address, pid, NX_BIT)
+#endif
+
 
 
 int main(int argc, char *argv[]) {
@@ -63,7 +72,7 @@ int main(int argc, char *argv[]) {
     /* verify that child's copy is non-executable */
     printf(TAG_PROGRESS "Child entry should have NX bit set\n");
 
-    if (ptedit_pte_get_bit(nx_function_aligned, pid, NX_BIT)) {
+    if (is_nx(nx_function_aligned, pid)) {
       printf(TAG_OK "Child mapping is non-executable\n");
     } else {
       printf(TAG_FAIL "Child mapping is executable\n");
@@ -71,11 +80,11 @@ int main(int argc, char *argv[]) {
 
     /* clear the non-executable (NX) bit and update child's page-table entry */
     printf(TAG_PROGRESS "Clearing child's NX bit...\n");
-    ptedit_pte_clear_bit(nx_function_aligned, pid, NX_BIT);
+    clear_nx(nx_function_aligned, pid);
 
     printf(TAG_PROGRESS "Check NX bit of child\n");
 
-    if (ptedit_pte_get_bit(nx_function_aligned, pid, NX_BIT)) {
+    if (is_nx(nx_function_aligned, pid)) {
       printf(TAG_FAIL "Child mapping is still non-executable\n");
     } else {
       printf(TAG_OK "Child mapping is executable\n");
@@ -84,7 +93,7 @@ int main(int argc, char *argv[]) {
     /* verify that own page-tabel entry is still non-executable */
     printf(TAG_OK "Own entry should have NX bit set\n");
 
-    if (ptedit_pte_get_bit(nx_function_aligned, 0, NX_BIT)) {
+    if (is_nx(nx_function_aligned, 0)) {
       printf(TAG_OK "Own mapping is non-executable\n");
     } else {
       printf(TAG_FAIL "Own mapping is executable\n");
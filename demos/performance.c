@@ -24,7 +24,7 @@ uint64_t rdtsc() {
   a = (d << 32) | a;
   asm volatile("mfence");
   return a;
-#elif defined(__aarch64__)
+#elif defined(__aarch64__) || defined(__riscv)
 #include <time.h>
   struct timespec t1;
   clock_gettime(CLOCK_MONOTONIC, &t1);
@@ -23,7 +23,7 @@ uint64_t rdtsc() {
   a = (d << 32) | a;
   asm volatile("mfence");
   return a;
-#elif defined(__aarch64__)
+#elif defined(__aarch64__) || defined(__riscv)
 #include <time.h>
   struct timespec t1;
   clock_gettime(CLOCK_MONOTONIC, &t1);
@@ -31,38 +31,43 @@ uint64_t rdtsc() {
 #endif
 }
 
+#if defined(__i386__) || defined(__x86_64__)
 void maccess(void *p) { asm volatile("movq (%0), %%rax\n" : : "c"(p) : "rax"); }
+#else
+void maccess(void *p) { (void)*(volatile char*)p; }
+#endif
 
-int main(int argc, char *argv[]) {
-    unsigned long target = 'X';
-    if (ptedit_init()) {
-      printf(TAG_FAIL "Error: Could not initalize PTEditor, did you load the kernel module?\n");
-      return 1;
+void measure(int method, const char* name, void* target) {
+    printf(TAG_OK "Setting TLB invalidation method to %s version\n", name);
+    if (ptedit_switch_tlb_invalidation(method)) {
+      printf(TAG_FAIL "Method not supported by the kernel module\n");
+      return;
     }
 
-    printf(TAG_OK "Setting TLB invalidation method to kernel version\n");
-    ptedit_switch_tlb_invalidation(PTEDITOR_TLB_INVALIDATION_KERNEL);
-
     size_t total = 0;
     for(int i=0; i<REPEAT; i++) {
-        maccess(&target);
+        maccess(target);
         size_t start = rdtsc();
-        ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_INVALIDATE_TLB, (size_t)&target);
+        /* Naming the process lets the PCID and cpumask modes target its address space */
+        ptedit_invalidate_tlb_range(getpid(), target, (char*)target + 1);
         total += rdtsc() - start;
     }
     printf(TAG_OK "TLB invalidation: %f\n", ((float)total)/REPEAT);
+}
 
-    printf(TAG_OK "Setting TLB invalidation method to kernel version\n");
-    ptedit_switch_tlb_invalidation(PTEDITOR_TLB_INVALIDATION_CUSTOM);
-
-    for(int i=0; i<REPEAT; i++) {
-        maccess(&target);
-        size_t start = rdtsc();
-        ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_INVALIDATE_TLB, (size_t)&target);
-        total += rdtsc() - start;
+int main(int argc, char *argv[]) {
+    unsigned long target = 'X';
+    if (ptedit_init()) {
+      printf(TAG_FAIL "Error: Could not initalize PTEditor, did you load the kernel module?\n");
+      return 1;
     }
-    printf(TAG_OK "TLB invalidation: %f\n", ((float)total)/REPEAT);
 
+    measure(PTEDITOR_TLB_INVALIDATION_KERNEL, "kernel", &target);
+    measure(PTEDITOR_TLB_INVALIDATION_CUSTOM, "custom", &target);
+    measure(PTEDITOR_TLB_INVALIDATION_CUSTOM_PCID, "PCID-aware custom", &target);
+    measure(PTEDITOR_TLB_INVALIDATION_CUSTOM_CPUMASK, "cpumask custom", &target);
+
+    ptedit_switch_tlb_invalidation(PTEDITOR_TLB_INVALIDATION_KERNEL);
     ptedit_cleanup();
 
     printf(TAG_OK "Done\n");
@@ -92,6 +92,32 @@ void maccess(void *p) {
 
 // ---------------------------------------------------------------------------
 void mfence() { asm volatile("DSB ISH"); }
+#elif defined(__riscv)
+#include <time.h>
+// ---------------------------------------------------------------------------
+uint64_t rdtsc() {
+  /* rdcycle is not accessible from user space since Linux 6.6 */
+  struct timespec t1;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  return t1.tv_sec * 1000 * 1000 * 1000ULL + t1.tv_nsec;
+}
+
+// ---------------------------------------------------------------------------
+void flush(void *p) {
+  /* cbo.flush (Zicbom), encoded directly as older assemblers do not know it */
+  asm volatile(".insn i 0x0f, 2, x0, %0, 2" ::"r"(p) : "memory");
+  asm volatile("fence rw, rw");
+}
+
+// ---------------------------------------------------------------------------
+void maccess(void *p) {
+  volatile uint32_t value;
+  asm volatile("lw %0, 0(%1)\n\t" : "=r"(value) : "r"(p));
+  asm volatile("fence rw, rw");
+}
+
+// ---------------------------------------------------------------------------
+void mfence() { asm volatile("fence rw, rw"); }
 #endif
 
 // ---------------------------------------------------------------------------
@@ -18,6 +18,9 @@ int is_normal_page(size_t entry) {
   return !(entry & (1ull << PTEDIT_PAGE_BIT_PSE));
 #elif defined(__aarch64__)
   return 1;
+#elif defined(__riscv)
+  /* Directory entries are neither readable nor executable */
+  return !(entry & ((1ull << PTEDIT_PAGE_BIT_READ) | (1ull << PTEDIT_PAGE_BIT_EXEC)));
 #endif
 }
 
@@ -12,11 +12,54 @@
 #include <linux/ptrace.h>
 #include <linux/proc_fs.h>
 #include <linux/kprobes.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
 #include <linux/mmap_lock.h>
 #endif
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#include <linux/sched/clock.h>
+#include <linux/sched/mm.h>
+#endif
+
+#if defined(CONFIG_MMU_NOTIFIER) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 0, 0)
+#include <linux/mmu_notifier.h>
+#include <linux/sched/mm.h>
+#include <linux/kfifo.h>
+#include <linux/poll.h>
+#define HAS_MMU_NOTIFIER 1
+#endif
+
+#if defined(__riscv) && defined(CONFIG_RISCV_SBI) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+#include <asm/sbi.h>
+#define HAS_RISCV_ASID_FENCE 1
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 3, 0)
+#include <linux/file.h>
+#define HAS_PIDFD 1
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+#include <linux/pagewalk.h>
+#define HAS_PAGEWALK 1
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+#include <linux/io_uring/cmd.h>
+#else
+#include <linux/io_uring.h>
+#endif
+#define HAS_URING_CMD 1
+#endif
+
 #ifdef CONFIG_PAGE_TABLE_ISOLATION
 pgd_t __attribute__((weak)) __pti_set_user_pgtbl(pgd_t *pgdp, pgd_t pgd);
 #endif
@@ -25,6 +68,9 @@ static int real_page_size = 4096, real_page_shift = 12;
 
 #include "pteditor.h"
 
+#define CREATE_TRACE_POINTS
+#include "pteditor_trace.h"
+
 MODULE_AUTHOR("Michael Schwarz");
 MODULE_DESCRIPTION("Device to play around with paging structures");
 MODULE_LICENSE("GPL");
@@ -71,23 +117,63 @@ static inline pteval_t native_pte_val(pte_t pte)
   return pte_val(pte);
 }
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 8, 0)
+/* Block mappings, pud_sect is 0 if the PMD level is folded */
 static inline int pud_large(pud_t pud) {
-#ifdef __PAGETABLE_PMD_FOLDED 
-    return pud_val(pud) && !(pud_val(pud) & PUD_TABLE_BIT);
-#else
-    return 0;
-#endif
+    return pud_sect(pud);
 }
 
 static inline int pmd_large(pmd_t pmd) {
-#ifdef __PAGETABLE_PMD_FOLDED
-    return pmd_val(pmd) && !(pmd_val(pmd) & PMD_TABLE_BIT)
-#else
-    return 0;
+    return pmd_sect(pmd);
+}
 #endif
+#elif defined(__riscv)
+#include <asm/csr.h>
+
+static inline pte_t native_make_pte(unsigned long val)
+{
+  return __pte(val);
+}
+
+static inline pgd_t native_make_pgd(unsigned long val)
+{
+  return __pgd(val);
 }
+
+static inline p4d_t native_make_p4d(unsigned long val)
+{
+  return __p4d(val);
+}
+
+static inline pud_t native_make_pud(unsigned long val)
+{
+  return __pud(val);
+}
+
+static inline pmd_t native_make_pmd(unsigned long val)
+{
+  return __pmd(val);
+}
+
+/* Not exported, resolved via kallsyms (they send the remote fences via IPI or SBI) */
+void (*flush_tlb_range_func)(struct vm_area_struct*, unsigned long, unsigned long);
+void (*flush_tlb_mm_func)(struct mm_struct*);
+#endif
+
+/* pud_large/pmd_large were replaced by pud_leaf/pmd_leaf (removed from x86 in 6.9) */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+#define pteditor_pud_leaf(x) pud_leaf(x)
+#define pteditor_pmd_leaf(x) pmd_leaf(x)
+#else
+#define pteditor_pud_leaf(x) pud_large(x)
+#define pteditor_pmd_leaf(x) pmd_large(x)
 #endif
 
+/* Raw entry values for cmpxchg, pteval_t/pmdval_t/pudval_t are not defined on every architecture */
+typedef typeof(pte_val(__pte(0))) pteditor_pteval_t;
+typedef typeof(pmd_val(__pmd(0))) pteditor_pmdval_t;
+typedef typeof(pud_val(__pud(0))) pteditor_pudval_t;
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
 #define from_user raw_copy_from_user
 #define to_user raw_copy_to_user
@@ -96,6 +182,18 @@ static inline int pmd_large(pmd_t pmd) {
 #define to_user copy_to_user
 #endif
 
+#ifndef TLB_FLUSH_ALL
+#define TLB_FLUSH_ALL -1UL
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 12, 0)
+#define batch_alloc(n, size) kvmalloc_array(n, size, GFP_KERNEL)
+#define batch_free kvfree
+#else
+#define batch_alloc(n, size) ((n) > SIZE_MAX / (size) ? NULL : vmalloc((n) * (size)))
+#define batch_free vfree
+#endif
+
 #ifdef pr_fmt
 #undef pr_fmt
 #endif
@@ -124,43 +222,122 @@ typedef struct {
     pmd_t *pmd;
     pte_t *pte;
     size_t valid;
+    size_t level;
+    size_t page_size;
 } vm_t;
 
-static bool device_busy = false;
-static bool mm_is_locked = false;
+/* Console logging of page-table updates, use the pteditor tracepoints for bulk updates */
+static bool verbose;
+module_param(verbose, bool, 0644);
+MODULE_PARM_DESC(verbose, "Log every page-table update to the kernel log");
 
-void (*invalidate_tlb)(unsigned long);
-void (*flush_tlb_mm_range_func)(struct mm_struct*, unsigned long, unsigned long, unsigned int, bool);
-void (*native_write_cr4_func)(unsigned long);
-static struct mm_struct* get_mm(size_t);
+/* Number of pages up to which a range is flushed page by page instead of flushing the whole TLB */
+static unsigned int tlb_flush_ceiling = 33;
+module_param(tlb_flush_ceiling, uint, 0644);
+MODULE_PARM_DESC(tlb_flush_ceiling, "Maximum number of pages flushed individually before falling back to a full TLB flush");
 
-static int device_open(struct inode *inode, struct file *file) {
-  /* Check if device is busy */
-  if (device_busy == true) {
-    return -EBUSY;
-  }
+/* Number of change events buffered per client, must be a power of 2 */
+#define WATCH_EVENTS 256
+
+/* Per-client state, stored in the private data of each opened file */
+typedef struct {
+    bool mm_is_locked;
+    /* Locked mm, referenced (mmgrab) while the lock is held as the session may outlive the locking task */
+    struct mm_struct *locked_mm;
+    void (*invalidate_tlb)(unsigned long);
+    void (*invalidate_tlb_range)(struct mm_struct*, unsigned long, unsigned long);
+    /* Process the session is attached to, its mm is pinned until the session is detached */
+    struct mm_struct *target_mm;
+#ifdef HAS_MMU_NOTIFIER
+    /* Change feed of a watched range, filled by the mmu notifier, drained by read() */
+    struct mmu_notifier notifier;
+    struct mm_struct *watched_mm;
+    unsigned long watch_start, watch_end;
+    DECLARE_KFIFO(events, ptedit_event_t, WATCH_EVENTS);
+    spinlock_t events_lock;
+    wait_queue_head_t events_wait;
+    bool events_lost;
+#endif
+} session_t;
 
-  device_busy = true;
+/* Statistics are kept per CPU and summed up when read, allocated dynamically as they exceed the static per-CPU reserve of modules */
+static ptedit_stats_t __percpu *pteditor_stats;
+static struct dentry *debugfs_dir;
 
-  return 0;
+static inline void stat_record(ptedit_stat_t __percpu *stat, u64 ns) {
+  this_cpu_inc(stat->count);
+  this_cpu_add(stat->total_ns, ns);
+  this_cpu_inc(stat->histogram[min(fls64(ns), PTEDIT_STATS_BUCKETS - 1)]);
 }
 
-static int device_release(struct inode *inode, struct file *file) {
-  /* Unlock module */
-  device_busy = false;
+static void stats_sum(ptedit_stats_t* sum) {
+  int cpu;
+  size_t i, n = sizeof(ptedit_stats_t) / sizeof(size_t);
+  memset(sum, 0, sizeof(ptedit_stats_t));
+  for_each_possible_cpu(cpu) {
+    size_t* counters = (size_t*)per_cpu_ptr(pteditor_stats, cpu);
+    for(i = 0; i < n; i++) ((size_t*)sum)[i] += counters[i];
+  }
+}
 
-  return 0;
+static void stats_reset(void) {
+  int cpu;
+  for_each_possible_cpu(cpu) {
+    memset(per_cpu_ptr(pteditor_stats, cpu), 0, sizeof(ptedit_stats_t));
+  }
 }
 
+void (*flush_tlb_mm_range_func)(struct mm_struct*, unsigned long, unsigned long, unsigned int, bool);
+void (*native_write_cr4_func)(unsigned long);
+#ifdef HAS_PAGEWALK
+int (*walk_page_range_func)(struct mm_struct*, unsigned long, unsigned long, const struct mm_walk_ops*, void*);
+#endif
+#ifdef HAS_PIDFD
+struct pid* (*pidfd_pid_func)(const struct file*);
+#endif
+static struct mm_struct* get_mm(size_t);
+
 static void
-_invalidate_tlb(void *addr) {
+_invalidate_tlb_all(void) {
 #if defined(__i386__) || defined(__x86_64__)
-  int pcid;
   unsigned long flags;
   unsigned long cr4;
 
+#if defined(X86_FEATURE_INVPCID_SINGLE) && defined(INVPCID_TYPE_INDIV_ADDR)
+  if (cpu_feature_enabled(X86_FEATURE_INVPCID_SINGLE)) {
+    invpcid_flush_all();
+    return;
+  }
+#endif
+  raw_local_irq_save(flags);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 8, 0)
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 0, 0)
+  cr4 = native_read_cr4();
+#else
+  cr4 = this_cpu_read(cpu_tlbstate.cr4);
+#endif
+#else
+  cr4 = __read_cr4();
+#endif
+  native_write_cr4_func(cr4 & ~X86_CR4_PGE);
+  native_write_cr4_func(cr4);
+  raw_local_irq_restore(flags);
+#elif defined(__aarch64__)
+  asm volatile ("dsb ishst");
+  asm volatile ("tlbi vmalle1is");
+  asm volatile ("dsb ish");
+  asm volatile ("isb");
+#elif defined(__riscv)
+  asm volatile ("sfence.vma" : : : "memory");
+#endif
+}
+
+static void
+_invalidate_tlb(void *addr) {
+#if defined(__i386__) || defined(__x86_64__)
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 2, 98)
 #if defined(X86_FEATURE_INVPCID_SINGLE) && defined(INVPCID_TYPE_INDIV_ADDR)
+  int pcid;
   if (cpu_feature_enabled(X86_FEATURE_INVPCID_SINGLE)) {
     for(pcid = 0; pcid < 4096; pcid++) {
       invpcid_flush_one(pcid, (long unsigned int) addr);
@@ -169,34 +346,229 @@ _invalidate_tlb(void *addr) {
   else 
 #endif
   {
-    raw_local_irq_save(flags);
-#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 8, 0)
-#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 0, 0)
-    cr4 = native_read_cr4();
+    _invalidate_tlb_all();
+  }
 #else
-    cr4 = this_cpu_read(cpu_tlbstate.cr4);
+  asm volatile ("invlpg (%0)": : "r"(addr));
 #endif
-#else
-    cr4 = __read_cr4();
+#elif defined(__aarch64__)
+  _invalidate_tlb_all();
+#elif defined(__riscv)
+  /* All address spaces (ASIDs) */
+  asm volatile ("sfence.vma %0" : : "r"(addr) : "memory");
 #endif
-    native_write_cr4_func(cr4 & ~X86_CR4_PGE);
-    native_write_cr4_func(cr4);
-    raw_local_irq_restore(flags);
+}
+
+typedef struct tlb_range_s {
+  unsigned long start;
+  unsigned long end;
+} tlb_range_t;
+
+static void
+_invalidate_tlb_range(void *info) {
+  tlb_range_t* range = (tlb_range_t*) info;
+  unsigned long addr;
+
+  if(range->end == TLB_FLUSH_ALL) {
+    _invalidate_tlb_all();
+    return;
   }
-#else
-  asm volatile ("invlpg (%0)": : "r"(addr));
+#if defined(__i386__) || defined(__x86_64__)
+#if defined(X86_FEATURE_INVPCID_SINGLE) && defined(INVPCID_TYPE_INDIV_ADDR)
+  if (!cpu_feature_enabled(X86_FEATURE_INVPCID_SINGLE))
 #endif
+  {
+    /* Without INVPCID, every flush is a full flush anyway */
+    _invalidate_tlb_all();
+    return;
+  }
+  for(addr = range->start; addr < range->end; addr += real_page_size) {
+    _invalidate_tlb((void*) addr);
+  }
 #elif defined(__aarch64__)
+  /* One barrier sequence for all pages, invalidates all ASIDs */
   asm volatile ("dsb ishst");
-  asm volatile ("tlbi vmalle1is");
+  for(addr = range->start; addr < range->end; addr += real_page_size) {
+    asm volatile ("tlbi vaae1is, %0" : : "r"(addr >> 12));
+  }
   asm volatile ("dsb ish");
   asm volatile ("isb");
+#elif defined(__riscv)
+  for(addr = range->start; addr < range->end; addr += real_page_size) {
+    _invalidate_tlb((void*) addr);
+  }
+#endif
+}
+
+#ifdef HAS_RISCV_ASID_FENCE
+/* Not exported, resolved via kallsyms, the ASID of an mm is context.id & asid_mask */
+static unsigned long *asid_mask_ptr;
+
+#ifdef FLUSH_TLB_NO_ASID
+#define sbi_fence_all_asids(mask, start, size) sbi_remote_sfence_vma_asid(mask, start, size, FLUSH_TLB_NO_ASID)
+#else
+#define sbi_fence_all_asids(mask, start, size) sbi_remote_sfence_vma(mask, start, size)
 #endif
+
+/* sfence.vma va, asid on the harts that ran the mm, the translations of other address spaces are kept */
+static void
+invalidate_tlb_riscv_range(struct mm_struct* mm, unsigned long start, unsigned long end) {
+  unsigned long size = end - start;
+  if(end == TLB_FLUSH_ALL) {
+    start = 0;
+    size = (unsigned long)-1;
+  }
+  if(!mm) {
+    /* Unknown address space, flush the addresses in all of them */
+    sbi_fence_all_asids(cpu_online_mask, start, size);
+  } else if(asid_mask_ptr) {
+    sbi_remote_sfence_vma_asid(mm_cpumask(mm), start, size, atomic_long_read(&mm->context.id) & *asid_mask_ptr);
+  } else {
+    sbi_fence_all_asids(mm_cpumask(mm), start, size);
+  }
 }
+#endif
 
 static void
 invalidate_tlb_custom(unsigned long addr) {
+#ifdef HAS_RISCV_ASID_FENCE
+  invalidate_tlb_riscv_range(NULL, addr, addr + real_page_size);
+#else
   on_each_cpu(_invalidate_tlb, (void*) addr, 1);
+#endif
+}
+
+static void
+invalidate_tlb_custom_range(struct mm_struct* mm, unsigned long start, unsigned long end) {
+  tlb_range_t range;
+  range.start = start;
+  range.end = end;
+  if(end != TLB_FLUSH_ALL && ((end - start) >> real_page_shift) > tlb_flush_ceiling) {
+    range.end = TLB_FLUSH_ALL;
+  }
+#ifdef HAS_RISCV_ASID_FENCE
+  invalidate_tlb_riscv_range(mm, range.start, range.end);
+#else
+  on_each_cpu(_invalidate_tlb_range, &range, 1);
+#endif
+}
+
+#if (defined(__i386__) || defined(__x86_64__)) && LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0) && defined(X86_FEATURE_INVPCID_SINGLE) && defined(INVPCID_TYPE_INDIV_ADDR)
+#define HAS_PCID_TRACKING 1
+#endif
+
+#ifdef HAS_PCID_TRACKING
+/* Not exported since 5.8, resolved via kallsyms */
+static struct tlb_state __percpu *cpu_tlbstate_ptr;
+
+/* Same mapping as kern_pcid/user_pcid in arch/x86/mm/tlb.c */
+#define PTEDIT_KERN_PCID(asid) ((asid) + 1)
+#define PTEDIT_USER_PCID(asid) (PTEDIT_KERN_PCID(asid) | (1 << 11))
+
+typedef struct tlb_pcid_s {
+  u64 ctx_id;
+  unsigned long start;
+  unsigned long end;
+} tlb_pcid_t;
+
+static void
+_invalidate_tlb_pcid(void *info) {
+  tlb_pcid_t* req = (tlb_pcid_t*) info;
+  struct tlb_state* state;
+  unsigned long addr;
+  u16 asid;
+
+  if (!cpu_feature_enabled(X86_FEATURE_INVPCID_SINGLE)) {
+    _invalidate_tlb_all();
+    return;
+  }
+  if (!cpu_feature_enabled(X86_FEATURE_PCID)) {
+    /* Everything is tagged with PCID 0 */
+    for(addr = req->start; addr < req->end; addr += real_page_size) {
+      invpcid_flush_one(0, addr);
+    }
+    return;
+  }
+
+  /* Only the dynamic ASIDs this CPU currently assigns to the mm can hold its translations */
+  state = this_cpu_ptr(cpu_tlbstate_ptr);
+  for(asid = 0; asid < TLB_NR_DYN_ASIDS; asid++) {
+    if(state->ctxs[asid].ctx_id != req->ctx_id) continue;
+    if(req->end == TLB_FLUSH_ALL) {
+      invpcid_flush_single_context(PTEDIT_KERN_PCID(asid));
+      if(cpu_feature_enabled(X86_FEATURE_PTI)) invpcid_flush_single_context(PTEDIT_USER_PCID(asid));
+      continue;
+    }
+    for(addr = req->start; addr < req->end; addr += real_page_size) {
+      invpcid_flush_one(PTEDIT_KERN_PCID(asid), addr);
+      if(cpu_feature_enabled(X86_FEATURE_PTI)) invpcid_flush_one(PTEDIT_USER_PCID(asid), addr);
+    }
+  }
+}
+#endif
+
+static void
+invalidate_tlb_pcid_range(struct mm_struct* mm, unsigned long start, unsigned long end) {
+#ifdef HAS_PCID_TRACKING
+  tlb_pcid_t req;
+  if(!cpu_tlbstate_ptr || !mm) {
+    invalidate_tlb_custom_range(mm, start, end);
+    return;
+  }
+  req.ctx_id = mm->context.ctx_id;
+  req.start = start;
+  req.end = end;
+  if(end != TLB_FLUSH_ALL && ((end - start) >> real_page_shift) > tlb_flush_ceiling) {
+    req.end = TLB_FLUSH_ALL;
+  }
+  on_each_cpu(_invalidate_tlb_pcid, &req, 1);
+#else
+  invalidate_tlb_custom_range(mm, start, end);
+#endif
+}
+
+static void
+invalidate_tlb_pcid(unsigned long addr) {
+  /* The address space is unknown (e.g., INVALIDATE_TLB for another process), flush all PCIDs */
+  invalidate_tlb_custom(addr);
+}
+
+static void
+invalidate_tlb_cpumask_range(struct mm_struct* mm, unsigned long start, unsigned long end) {
+#ifdef HAS_PCID_TRACKING
+  tlb_pcid_t req;
+  tlb_range_t range;
+  if(!mm) {
+    invalidate_tlb_custom_range(mm, start, end);
+    return;
+  }
+  if(end != TLB_FLUSH_ALL && ((end - start) >> real_page_shift) > tlb_flush_ceiling) {
+    start = 0;
+    end = TLB_FLUSH_ALL;
+  }
+  /* CPUs that are not in the mask flush the stale ASID of the mm when switching back to it,
+   * same bookkeeping as flush_tlb_mm_range() (fully ordered before the IPIs) */
+  inc_mm_tlb_gen(mm);
+  if(cpu_tlbstate_ptr) {
+    req.ctx_id = mm->context.ctx_id;
+    req.start = start;
+    req.end = end;
+    on_each_cpu_mask(mm_cpumask(mm), _invalidate_tlb_pcid, &req, 1);
+  } else {
+    range.start = start;
+    range.end = end;
+    on_each_cpu_mask(mm_cpumask(mm), _invalidate_tlb_range, &range, 1);
+  }
+#else
+  /* The cpumask of the mm is not maintained (e.g., arm64 uses broadcast TLB maintenance) */
+  invalidate_tlb_custom_range(mm, start, end);
+#endif
+}
+
+static void
+invalidate_tlb_cpumask(unsigned long addr) {
+  /* Neither the cpumask nor the tlb_gen of the target is known, broadcast to all CPUs and PCIDs */
+  invalidate_tlb_custom(addr);
 }
 
 #if defined(__aarch64__)
@@ -224,6 +596,41 @@ invalidate_tlb_kernel(unsigned long addr) {
   tlb_page.vma = vma;
   tlb_page.addr = addr;
   on_each_cpu(_flush_tlb_page_smp, &tlb_page, 1);
+#elif defined(__riscv)
+  struct vm_area_struct *vma = find_vma(current->mm, addr);
+  if (unlikely(vma == NULL || addr < vma->vm_start)) {
+    return;
+  }
+  flush_tlb_range_func(vma, addr, addr + real_page_size);
+#endif
+}
+
+static void
+invalidate_tlb_kernel_range(struct mm_struct* mm, unsigned long start, unsigned long end) {
+#if defined(__aarch64__) || defined(__riscv)
+  struct vm_area_struct *vma;
+#endif
+  if(end != TLB_FLUSH_ALL && ((end - start) >> real_page_shift) > tlb_flush_ceiling) {
+    start = 0;
+    end = TLB_FLUSH_ALL;
+  }
+#if defined(__i386__) || defined(__x86_64__)
+  flush_tlb_mm_range_func(mm, start, end, real_page_shift, false);
+#elif defined(__aarch64__)
+  /* The range flush only uses the mm of the VMA, any VMA of the mm works */
+  vma = (end == TLB_FLUSH_ALL) ? NULL : find_vma(mm, start);
+  if(vma) {
+    flush_tlb_range(vma, start, end);
+  } else {
+    flush_tlb_mm(mm);
+  }
+#elif defined(__riscv)
+  vma = (end == TLB_FLUSH_ALL) ? NULL : find_vma(mm, start);
+  if(vma) {
+    flush_tlb_range_func(vma, start, end);
+  } else {
+    flush_tlb_mm_func(mm);
+  }
 #endif
 }
 
@@ -237,6 +644,9 @@ static void _set_pat(void* _pat) {
 #elif defined(__aarch64__)
     size_t pat = (size_t)_pat;
     asm volatile ("msr mair_el1, %0\n" : : "r"(pat));
+#elif defined(__riscv)
+    /* The memory types (Svpbmt) are encoded in the entries, there is nothing to configure */
+    (void)_pat;
 #endif
 }
 
@@ -244,6 +654,23 @@ static void set_pat(size_t pat) {
     on_each_cpu(_set_pat, (void*) pat, 1);
 }
 
+/* Number of page-table levels used by the MMU */
+static int paging_levels(void) {
+#if defined(__x86_64__) && CONFIG_PGTABLE_LEVELS > 4 && LINUX_VERSION_CODE >= KERNEL_VERSION(4, 17, 0)
+  /* 5-level kernels fall back to 4-level paging if LA57 is not supported */
+  return pgtable_l5_enabled() ? 5 : 4;
+#elif defined(__riscv)
+  /* The kernel picks the largest mode the hart supports, Sv39 (8), Sv48 (9), or Sv57 (10) */
+  switch(csr_read(CSR_SATP) >> 60) {
+    case 10: return 5;
+    case 9: return 4;
+    default: return 3;
+  }
+#else
+  return CONFIG_PGTABLE_LEVELS;
+#endif
+}
+
 static struct mm_struct* get_mm(size_t pid) {
   struct task_struct *task;
   struct pid* vpid;
@@ -264,8 +691,158 @@ static struct mm_struct* get_mm(size_t pid) {
   return NULL;
 }
 
-static int resolve_vm(size_t addr, vm_t* entry, int lock) {
+/* The pinned mm if the session is attached to a process (the pid is ignored), otherwise the mm of the pid */
+static struct mm_struct* session_mm(session_t* session, size_t pid) {
+  if(session->target_mm) return session->target_mm;
+  return get_mm(pid);
+}
+
+static void lock_mm(struct mm_struct *mm, int write) {
+  u64 start = local_clock();
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+  if(write) mmap_write_lock(mm);
+  else mmap_read_lock(mm);
+#else
+  if(write) down_write(&mm->mmap_sem);
+  else down_read(&mm->mmap_sem);
+#endif
+  stat_record(&pteditor_stats->lock, local_clock() - start);
+}
+
+static void unlock_mm(struct mm_struct *mm, int write) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+  if(write) mmap_write_unlock(mm);
+  else mmap_read_unlock(mm);
+#else
+  if(write) up_write(&mm->mmap_sem);
+  else up_read(&mm->mmap_sem);
+#endif
+}
+
+static void invalidate(session_t* session, size_t pid, unsigned long addr) {
+  u64 start = local_clock();
+  session->invalidate_tlb(addr);
+  stat_record(&pteditor_stats->flush, local_clock() - start);
+  trace_pteditor_invalidate(pid, addr, addr + real_page_size);
+}
+
+static void invalidate_range(session_t* session, size_t pid, struct mm_struct *mm, unsigned long start, unsigned long end) {
+  u64 begin = local_clock();
+  session->invalidate_tlb_range(mm, start, end);
+  stat_record(&pteditor_stats->flush, local_clock() - begin);
+  trace_pteditor_invalidate(pid, start, end);
+}
+
+static int resolve_vm_mm(struct mm_struct *mm, size_t addr, vm_t* entry) {
+  entry->pud = NULL;
+  entry->pmd = NULL;
+  entry->pgd = NULL;
+  entry->pte = NULL;
+  entry->p4d = NULL;
+  entry->valid = 0;
+  entry->level = 0;
+  entry->page_size = 0;
+
+  /* Return PGD (page global directory) entry */
+  entry->pgd = pgd_offset(mm, addr);
+  if (pgd_none(*(entry->pgd)) || pgd_bad(*(entry->pgd))) {
+      entry->pgd = NULL;
+      return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_PGD;
+
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+  /* Return p4d offset */
+  entry->p4d = p4d_offset(entry->pgd, addr);
+  if (p4d_none(*(entry->p4d)) || p4d_bad(*(entry->p4d))) {
+    entry->p4d = NULL;
+    return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_P4D;
+
+  /* Get offset of PUD (page upper directory) */
+  entry->pud = pud_offset(entry->p4d, addr);
+  if (pud_none(*(entry->pud))) {
+    entry->pud = NULL;
+    return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_PUD;
+#else
+  /* Get offset of PUD (page upper directory) */
+  entry->pud = pud_offset(entry->pgd, addr);
+  if (pud_none(*(entry->pud))) {
+    entry->pud = NULL;
+    return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_PUD;
+#endif
+
+
+  /* 1 GB page, the PUD is the leaf */
+  if (pteditor_pud_leaf(*(entry->pud))) {
+    entry->level = PTEDIT_VALID_MASK_PUD;
+    entry->page_size = PUD_SIZE;
+    return 0;
+  }
+
+  /* Get offset of PMD (page middle directory) */
+  entry->pmd = pmd_offset(entry->pud, addr);
+  if (pmd_none(*(entry->pmd))) {
+    entry->pmd = NULL;
+    return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_PMD;
+
+  /* 2 MB page, the PMD is the leaf (do not map the PTE, there is no page table) */
+  if (pteditor_pmd_leaf(*(entry->pmd))) {
+    entry->level = PTEDIT_VALID_MASK_PMD;
+    entry->page_size = PMD_SIZE;
+    return 0;
+  }
+
+  /* Map PTE (page table entry) */
+  entry->pte = pte_offset_map(entry->pmd, addr);
+  if (entry->pte == NULL) {
+    return 1;
+  }
+  entry->valid |= PTEDIT_VALID_MASK_PTE;
+  entry->level = PTEDIT_VALID_MASK_PTE;
+  entry->page_size = real_page_size;
+
+  /* Unmap PTE, fine on x86 and ARM64 -> unmap is NOP */
+  pte_unmap(entry->pte);
+
+  return 0;
+}
+
+static void trace_resolve(vm_t* entry, size_t addr) {
+  size_t level = 0, value = 0;
+  if(!trace_pteditor_resolve_enabled()) return;
+  if(entry->valid & PTEDIT_VALID_MASK_PTE) {
+    level = PTEDIT_VALID_MASK_PTE;
+    value = pte_val(*entry->pte);
+  } else if(entry->valid & PTEDIT_VALID_MASK_PMD) {
+    level = PTEDIT_VALID_MASK_PMD;
+    value = pmd_val(*entry->pmd);
+  } else if(entry->valid & PTEDIT_VALID_MASK_PUD) {
+    level = PTEDIT_VALID_MASK_PUD;
+    value = pud_val(*entry->pud);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+  } else if(entry->valid & PTEDIT_VALID_MASK_P4D) {
+    level = PTEDIT_VALID_MASK_P4D;
+    value = p4d_val(*entry->p4d);
+#endif
+  } else if(entry->valid & PTEDIT_VALID_MASK_PGD) {
+    level = PTEDIT_VALID_MASK_PGD;
+    value = pgd_val(*entry->pgd);
+  }
+  trace_pteditor_resolve(entry->pid, addr, level, value);
+}
+
+static int resolve_vm(session_t* session, size_t addr, vm_t* entry, int lock) {
   struct mm_struct *mm;
+  int ret;
 
   if(!entry) return 1;
   entry->pud = NULL;
@@ -274,182 +851,874 @@ static int resolve_vm(size_t addr, vm_t* entry, int lock) {
   entry->pte = NULL;
   entry->p4d = NULL;
   entry->valid = 0;
+  entry->level = 0;
+  entry->page_size = 0;
 
-  mm = get_mm(entry->pid);
+  mm = session_mm(session, entry->pid);
   if(!mm) {
       return 1;
   }
 
   /* Lock mm */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-  if(lock) mmap_read_lock(mm);
+  if(lock) lock_mm(mm, 0);
+
+  ret = resolve_vm_mm(mm, addr, entry);
+  trace_resolve(entry, addr);
+
+  /* Unlock mm */
+  if(lock) unlock_mm(mm, 0);
+
+  return ret;
+}
+
+
+static void update_vm_mm(struct mm_struct *mm, ptedit_entry_t* new_entry) {
+  vm_t old_entry;
+
+  old_entry.pid = new_entry->pid;
+  resolve_vm_mm(mm, new_entry->vaddr, &old_entry);
+
+  /* Update entries */
+  if((old_entry.valid & PTEDIT_VALID_MASK_PGD) && (new_entry->valid & PTEDIT_VALID_MASK_PGD)) {
+      if(verbose) pr_warn("Updating PGD\n");
+      trace_pteditor_update(new_entry->pid, new_entry->vaddr, PTEDIT_VALID_MASK_PGD, pgd_val(*old_entry.pgd), new_entry->pgd);
+      set_pgd(old_entry.pgd, native_make_pgd(new_entry->pgd));
+  }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+  if((old_entry.valid & PTEDIT_VALID_MASK_P4D) && (new_entry->valid & PTEDIT_VALID_MASK_P4D)) {
+      if(verbose) pr_warn("Updating P4D\n");
+      trace_pteditor_update(new_entry->pid, new_entry->vaddr, PTEDIT_VALID_MASK_P4D, p4d_val(*old_entry.p4d), new_entry->p4d);
+      set_p4d(old_entry.p4d, native_make_p4d(new_entry->p4d));
+  }
+#endif
+
+  if((old_entry.valid & PTEDIT_VALID_MASK_PUD) && (new_entry->valid & PTEDIT_VALID_MASK_PUD)) {
+      if(verbose) pr_warn("Updating PUD\n");
+      trace_pteditor_update(new_entry->pid, new_entry->vaddr, PTEDIT_VALID_MASK_PUD, pud_val(*old_entry.pud), new_entry->pud);
+      set_pud(old_entry.pud, native_make_pud(new_entry->pud));
+  }
+
+  if((old_entry.valid & PTEDIT_VALID_MASK_PMD) && (new_entry->valid & PTEDIT_VALID_MASK_PMD)) {
+      if(verbose) pr_warn("Updating PMD\n");
+      trace_pteditor_update(new_entry->pid, new_entry->vaddr, PTEDIT_VALID_MASK_PMD, pmd_val(*old_entry.pmd), new_entry->pmd);
+      set_pmd(old_entry.pmd, native_make_pmd(new_entry->pmd));
+  }
+
+  if((old_entry.valid & PTEDIT_VALID_MASK_PTE) && (new_entry->valid & PTEDIT_VALID_MASK_PTE)) {
+      if(verbose) pr_warn("Updating PTE\n");
+      trace_pteditor_update(new_entry->pid, new_entry->vaddr, PTEDIT_VALID_MASK_PTE, pte_val(*old_entry.pte), new_entry->pte);
+      set_pte(old_entry.pte, native_make_pte(new_entry->pte));
+  }
+}
+
+static int update_vm(session_t* session, ptedit_entry_t* new_entry, int lock) {
+  size_t addr = new_entry->vaddr;
+  struct mm_struct *mm = session_mm(session, new_entry->pid);
+  if(!mm) return 1;
+
+  /* Lock mm */
+  if(lock) lock_mm(mm, 1);
+
+  update_vm_mm(mm, new_entry);
+
+  /* Flush in the address space of the target, not the caller (e.g., only its PCIDs) */
+  invalidate_range(session, new_entry->pid, mm, addr & ~((size_t)real_page_size - 1), (addr & ~((size_t)real_page_size - 1)) + real_page_size);
+
+  /* Unlock mm */
+  if(lock) unlock_mm(mm, 1);
+
+  return 0;
+}
+
+static int update_vm_batch(session_t* session, ptedit_batch_t* batch, int lock) {
+  struct mm_struct *mm;
+  ptedit_entry_t* entries;
+  unsigned long start = ULONG_MAX, end = 0;
+  size_t i;
+
+  if(!batch->count) return 0;
+  mm = session_mm(session, batch->pid);
+  if(!mm) return 1;
+
+  entries = batch_alloc(batch->count, sizeof(ptedit_entry_t));
+  if(!entries) return -ENOMEM;
+  if(from_user(entries, batch->data, batch->count * sizeof(ptedit_entry_t))) {
+    batch_free(entries);
+    return -EFAULT;
+  }
+
+  /* Lock mm */
+  if(lock) lock_mm(mm, 1);
+
+  for(i = 0; i < batch->count; i++) {
+    entries[i].pid = batch->pid;
+    update_vm_mm(mm, &entries[i]);
+    if(entries[i].vaddr < start) start = entries[i].vaddr;
+    if(entries[i].vaddr > end) end = entries[i].vaddr;
+  }
+
+  /* One flush for the whole batch, invalidate_tlb_range falls back to a full flush for large ranges */
+  start &= ~((unsigned long)real_page_size - 1);
+  end = (end & ~((unsigned long)real_page_size - 1)) + real_page_size;
+  if(batch->count > tlb_flush_ceiling) {
+    start = 0;
+    end = TLB_FLUSH_ALL;
+  }
+  invalidate_range(session, batch->pid, mm, start, end);
+
+  /* Unlock mm */
+  if(lock) unlock_mm(mm, 1);
+
+  batch_free(entries);
+  return 0;
+}
+
+static int copy_pages(ptedit_batch_t* batch, int write) {
+  ptedit_page_t* pages;
+  size_t i, pfn, length;
+  int ret = 0;
+
+  if(!batch->count) return 0;
+  pages = batch_alloc(batch->count, sizeof(ptedit_page_t));
+  if(!pages) return -ENOMEM;
+  if(from_user(pages, batch->data, batch->count * sizeof(ptedit_page_t))) {
+    batch_free(pages);
+    return -EFAULT;
+  }
+
+  for(i = 0; i < batch->count; i++) {
+    length = pages[i].size ? pages[i].size : real_page_size;
+    /* Only copy from frames backed by the direct mapping */
+    for(pfn = pages[i].pfn; pfn <= pages[i].pfn + (length - 1) / real_page_size; pfn++) {
+      if(!pfn_valid(pfn)) {
+        ret = -EINVAL;
+        goto out;
+      }
+    }
+    if(write) {
+      if(from_user(phys_to_virt(pages[i].pfn * real_page_size), pages[i].buffer, length)) {
+        ret = -EFAULT;
+        goto out;
+      }
+    } else {
+      if(to_user(pages[i].buffer, phys_to_virt(pages[i].pfn * real_page_size), length)) {
+        ret = -EFAULT;
+        goto out;
+      }
+    }
+    cond_resched();
+  }
+
+out:
+  batch_free(pages);
+  return ret;
+}
+
+
+static void vm_to_user(ptedit_entry_t* user, vm_t* vm) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#if CONFIG_PGTABLE_LEVELS > 4
+    if(vm->p4d) user->p4d = (vm->p4d)->p4d;
+#else
+#if !defined(__ARCH_HAS_5LEVEL_HACK)
+    if(vm->p4d) user->p4d = (vm->p4d)->pgd.pgd;
 #else
-  if(lock) down_read(&mm->mmap_sem);
+    if(vm->p4d) user->p4d = (vm->p4d)->pgd;    
+#endif
+#endif
 #endif
+#if defined(__i386__) || defined(__x86_64__)
+    if(vm->pgd) user->pgd = (vm->pgd)->pgd;
+    if(vm->pmd) user->pmd = (vm->pmd)->pmd;
+    if(vm->pud) user->pud = (vm->pud)->pud;
+    if(vm->pte) user->pte = (vm->pte)->pte;
+#elif defined(__aarch64__) || defined(__riscv)
+    if(vm->pgd) user->pgd = pgd_val(*(vm->pgd));
+    if(vm->pmd) user->pmd = pmd_val(*(vm->pmd));
+    if(vm->pud) user->pud = pud_val(*(vm->pud));
+    if(vm->pte) user->pte = pte_val(*(vm->pte));
+#endif
+    user->valid = vm->valid;
+    user->level = vm->level;
+    user->page_size = vm->page_size;
+}
 
-  /* Return PGD (page global directory) entry */
-  entry->pgd = pgd_offset(mm, addr);
-  if (pgd_none(*(entry->pgd)) || pgd_bad(*(entry->pgd))) {
-      entry->pgd = NULL;
-      goto error_out;
+
+static int resolve_vm_batch(session_t* session, ptedit_batch_t* batch, int lock) {
+  struct mm_struct *mm;
+  ptedit_entry_t* entries;
+  vm_t vm;
+  size_t i, vaddr;
+
+  if(!batch->count) return 0;
+  entries = batch_alloc(batch->count, sizeof(ptedit_entry_t));
+  if(!entries) return -ENOMEM;
+  if(from_user(entries, batch->data, batch->count * sizeof(ptedit_entry_t))) {
+    batch_free(entries);
+    return -EFAULT;
+  }
+
+  /* Look up and lock the mm only once for all entries */
+  mm = session_mm(session, batch->pid);
+  if(mm) {
+    if(lock) lock_mm(mm, 0);
+  }
+
+  for(i = 0; i < batch->count; i++) {
+    vaddr = entries[i].vaddr;
+    memset(&entries[i], 0, sizeof(ptedit_entry_t));
+    entries[i].vaddr = vaddr;
+    entries[i].pid = batch->pid;
+    if(!mm) continue;
+    vm.pid = batch->pid;
+    resolve_vm_mm(mm, entries[i].vaddr, &vm);
+    trace_resolve(&vm, entries[i].vaddr);
+    vm_to_user(&entries[i], &vm);
+  }
+
+  if(mm) {
+    if(lock) unlock_mm(mm, 0);
+  }
+
+  /* Copy back only after the lock is dropped, faulting on the buffer needs mmap_lock */
+  if(to_user(batch->data, entries, batch->count * sizeof(ptedit_entry_t))) {
+    batch_free(entries);
+    return -EFAULT;
+  }
+  batch_free(entries);
+  return 0;
+}
+
+
+/* Upper bound for the kernel buffer of a single dump, user space continues with the cursor */
+#define DUMP_MAX_LEAVES (1 << 16)
+
+#ifdef HAS_PAGEWALK
+typedef struct {
+  ptedit_leaf_t* leaves;
+  size_t count;
+  size_t capacity;
+  unsigned long next;
+} dump_walk_t;
+
+static int dump_add_leaf(struct mm_walk *walk, unsigned long addr, size_t entry, size_t level, size_t size) {
+  dump_walk_t* dump = (dump_walk_t*)walk->private;
+  ptedit_leaf_t* leaf;
+
+  if(dump->count >= dump->capacity) {
+    /* Buffer is full, the next dump starts at this leaf */
+    dump->next = addr;
+    return 1;
+  }
+  leaf = &dump->leaves[dump->count++];
+  leaf->vaddr = addr & ~(size - 1);
+  leaf->entry = entry;
+  leaf->level = level;
+  leaf->size = size;
+  return 0;
+}
+
+static int dump_pud_entry(pud_t *pud, unsigned long addr, unsigned long next, struct mm_walk *walk) {
+  pud_t val = READ_ONCE(*pud);
+  if(!pud_present(val)) {
+    walk->action = ACTION_CONTINUE;
+    return 0;
+  }
+  if(pteditor_pud_leaf(val)) {
+    walk->action = ACTION_CONTINUE;
+    return dump_add_leaf(walk, addr, pud_val(val), PTEDIT_VALID_MASK_PUD, PUD_SIZE);
+  }
+  return 0;
+}
+
+static int dump_pmd_entry(pmd_t *pmd, unsigned long addr, unsigned long next, struct mm_walk *walk) {
+  pmd_t val = READ_ONCE(*pmd);
+  if(!pmd_present(val)) {
+    walk->action = ACTION_CONTINUE;
+    return 0;
+  }
+  if(pteditor_pmd_leaf(val)) {
+    /* Do not descend, otherwise the walker splits the huge page */
+    walk->action = ACTION_CONTINUE;
+    return dump_add_leaf(walk, addr, pmd_val(val), PTEDIT_VALID_MASK_PMD, PMD_SIZE);
+  }
+  return 0;
+}
+
+static int dump_pte_entry(pte_t *pte, unsigned long addr, unsigned long next, struct mm_walk *walk) {
+  pte_t val = READ_ONCE(*pte);
+  if(!pte_present(val)) return 0;
+  return dump_add_leaf(walk, addr, pte_val(val), PTEDIT_VALID_MASK_PTE, real_page_size);
+}
+
+#ifdef CONFIG_HUGETLB_PAGE
+static int dump_hugetlb_entry(pte_t *pte, unsigned long hmask, unsigned long addr, unsigned long next, struct mm_walk *walk) {
+  pte_t val = READ_ONCE(*pte);
+  size_t size = ~hmask + 1;
+  size_t level = PTEDIT_VALID_MASK_PTE;
+
+  if(!pte_present(val)) return 0;
+  if(size >= PUD_SIZE) level = PTEDIT_VALID_MASK_PUD;
+  else if(size >= PMD_SIZE) level = PTEDIT_VALID_MASK_PMD;
+  return dump_add_leaf(walk, addr, pte_val(val), level, size);
+}
+#endif
+
+static const struct mm_walk_ops dump_walk_ops = {
+  .pud_entry = dump_pud_entry,
+  .pmd_entry = dump_pmd_entry,
+  .pte_entry = dump_pte_entry,
+#ifdef CONFIG_HUGETLB_PAGE
+  .hugetlb_entry = dump_hugetlb_entry,
+#endif
+};
+#endif
+
+static int dump_vm(session_t* session, ptedit_range_t* range, int lock) {
+#ifdef HAS_PAGEWALK
+  struct mm_struct *mm;
+  dump_walk_t dump;
+  unsigned long start = range->start & ~((unsigned long)real_page_size - 1);
+
+  if(!walk_page_range_func) return -ENOSYS;
+  mm = session_mm(session, range->pid);
+  if(!mm) return 1;
+
+  dump.count = 0;
+  dump.next = range->end;
+  dump.capacity = min_t(size_t, range->count, DUMP_MAX_LEAVES);
+  range->count = 0;
+  if(start >= range->end || !dump.capacity) {
+    return 0;
+  }
+  dump.leaves = batch_alloc(dump.capacity, sizeof(ptedit_leaf_t));
+  if(!dump.leaves) return -ENOMEM;
+
+  /* Lock mm */
+  if(lock) lock_mm(mm, 0);
+
+  walk_page_range_func(mm, start, range->end, &dump_walk_ops, &dump);
+
+  /* Unlock mm */
+  if(lock) unlock_mm(mm, 0);
+
+  range->start = dump.next;
+  range->count = dump.count;
+  if(to_user(range->leaves, dump.leaves, dump.count * sizeof(ptedit_leaf_t))) {
+    batch_free(dump.leaves);
+    return -EFAULT;
+  }
+  batch_free(dump.leaves);
+  return 0;
+#else
+  return -ENOSYS;
+#endif
+}
+
+
+/* Upper bound for the number of pages of a single harvest (1 TB with 4 KB pages), user space splits larger ranges */
+#define HARVEST_MAX_PAGES (1ul << 28)
+
+#ifdef HAS_PAGEWALK
+typedef struct {
+  unsigned long start;
+  size_t flags;
+  unsigned long* accessed;
+  unsigned long* dirty;
+  /* Range with cleared bits, flushed once after the walk */
+  unsigned long flush_start;
+  unsigned long flush_end;
+} harvest_walk_t;
+
+static void harvest_mark(harvest_walk_t* harvest, unsigned long addr, unsigned long end, int young, int dirty) {
+  unsigned long first = (addr - harvest->start) >> real_page_shift;
+  unsigned long count = (end - addr) >> real_page_shift;
+  if(young && harvest->accessed) bitmap_set(harvest->accessed, first, count);
+  if(dirty && harvest->dirty) bitmap_set(harvest->dirty, first, count);
+}
+
+static void harvest_cleared(harvest_walk_t* harvest, struct vm_area_struct* vma, unsigned long addr, unsigned long end, unsigned long pfn, int dirty) {
+  if(addr < harvest->flush_start) harvest->flush_start = addr;
+  if(end > harvest->flush_end) harvest->flush_end = end;
+  /* Do not lose the dirty state of the page, e.g., for writeback or swap */
+  if(dirty && !(vma->vm_flags & (VM_PFNMAP | VM_IO)) && pfn_valid(pfn)) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 16, 0)
+    folio_mark_dirty(page_folio(pfn_to_page(pfn)));
+#else
+    set_page_dirty(pfn_to_page(pfn));
+#endif
+  }
+}
+
+static int harvest_pmd_entry(pmd_t *pmd, unsigned long addr, unsigned long next, struct mm_walk *walk) {
+  harvest_walk_t* harvest = (harvest_walk_t*)walk->private;
+  spinlock_t *ptl;
+  pmd_t old, new;
+
+  old = READ_ONCE(*pmd);
+  if(!pmd_present(old) || !pteditor_pmd_leaf(old)) return 0;
+  /* Serialized against splits and other updates of the huge page, as the kernel's own harvesters do */
+  ptl = pmd_lock(walk->mm, pmd);
+  old = *pmd;
+  if(!pmd_present(old) || !pteditor_pmd_leaf(old)) {
+    /* Split in the meantime, descend to the PTEs */
+    spin_unlock(ptl);
+    return 0;
+  }
+  /* Do not descend, otherwise the walker splits the huge page */
+  walk->action = ACTION_CONTINUE;
+  new = old;
+  if(harvest->flags & (PTEDIT_HARVEST_CLEAR_ACCESSED | PTEDIT_HARVEST_CLEAR_DIRTY)) {
+    /* Atomic with respect to the hardware setting accessed/dirty bits */
+    do {
+      old = READ_ONCE(*pmd);
+      new = old;
+      if(harvest->flags & PTEDIT_HARVEST_CLEAR_ACCESSED) new = pmd_mkold(new);
+      if(harvest->flags & PTEDIT_HARVEST_CLEAR_DIRTY) new = pmd_mkclean(new);
+      if(pmd_val(new) == pmd_val(old)) break;
+    } while(cmpxchg((pteditor_pmdval_t*)pmd, pmd_val(old), pmd_val(new)) != pmd_val(old));
+  }
+  spin_unlock(ptl);
+  if(pmd_val(new) != pmd_val(old)) {
+    harvest_cleared(harvest, walk->vma, addr, next, pmd_pfn(old), (harvest->flags & PTEDIT_HARVEST_CLEAR_DIRTY) && pmd_dirty(old));
+  }
+  harvest_mark(harvest, addr, next, pmd_young(old), pmd_dirty(old));
+  return 0;
+}
+
+static int harvest_pte_entry(pte_t *pte, unsigned long addr, unsigned long next, struct mm_walk *walk) {
+  harvest_walk_t* harvest = (harvest_walk_t*)walk->private;
+  pte_t old, new;
+
+  old = READ_ONCE(*pte);
+  if(!pte_present(old)) return 0;
+  if(harvest->flags & (PTEDIT_HARVEST_CLEAR_ACCESSED | PTEDIT_HARVEST_CLEAR_DIRTY)) {
+    /* Atomic with respect to the hardware setting accessed/dirty bits */
+    do {
+      old = READ_ONCE(*pte);
+      if(!pte_present(old)) return 0;
+      new = old;
+      if(harvest->flags & PTEDIT_HARVEST_CLEAR_ACCESSED) new = pte_mkold(new);
+      if(harvest->flags & PTEDIT_HARVEST_CLEAR_DIRTY) new = pte_mkclean(new);
+      if(pte_val(new) == pte_val(old)) break;
+    } while(cmpxchg((pteditor_pteval_t*)pte, pte_val(old), pte_val(new)) != pte_val(old));
+    if(pte_val(new) != pte_val(old)) {
+      harvest_cleared(harvest, walk->vma, addr, next, pte_pfn(old), (harvest->flags & PTEDIT_HARVEST_CLEAR_DIRTY) && pte_dirty(old));
+    }
+  }
+  harvest_mark(harvest, addr, next, pte_young(old), pte_dirty(old));
+  return 0;
+}
+
+#ifdef CONFIG_HUGETLB_PAGE
+static int harvest_hugetlb_entry(pte_t *pte, unsigned long hmask, unsigned long addr, unsigned long next, struct mm_walk *walk) {
+  /* Only reported, clearing would have to update all entries of contiguous hugetlb mappings */
+  pte_t val = READ_ONCE(*pte);
+  if(!pte_present(val)) return 0;
+  harvest_mark((harvest_walk_t*)walk->private, addr, next, pte_young(val), pte_dirty(val));
+  return 0;
+}
+#endif
+
+static const struct mm_walk_ops harvest_walk_ops = {
+  .pmd_entry = harvest_pmd_entry,
+  .pte_entry = harvest_pte_entry,
+#ifdef CONFIG_HUGETLB_PAGE
+  .hugetlb_entry = harvest_hugetlb_entry,
+#endif
+};
+#endif
+
+static int harvest_vm(session_t* session, ptedit_harvest_t* request, int lock) {
+#ifdef HAS_PAGEWALK
+  struct mm_struct *mm;
+  harvest_walk_t harvest;
+  unsigned long pages;
+  size_t bytes;
+  int ret = 0;
+
+  if(!walk_page_range_func) return -ENOSYS;
+  if(request->start & (real_page_size - 1)) return -EINVAL;
+  if(request->start >= request->end) return 0;
+  pages = (ALIGN(request->end, real_page_size) - request->start) >> real_page_shift;
+  if(pages > HARVEST_MAX_PAGES) return -EINVAL;
+  mm = session_mm(session, request->pid);
+  if(!mm) return 1;
+
+  bytes = BITS_TO_LONGS(pages) * sizeof(unsigned long);
+  memset(&harvest, 0, sizeof(harvest));
+  harvest.start = request->start;
+  harvest.flags = request->flags;
+  harvest.flush_start = ULONG_MAX;
+  if(request->accessed) harvest.accessed = batch_alloc(bytes, 1);
+  if(request->dirty) harvest.dirty = batch_alloc(bytes, 1);
+  if((request->accessed && !harvest.accessed) || (request->dirty && !harvest.dirty)) {
+    ret = -ENOMEM;
+    goto out;
   }
-  entry->valid |= PTEDIT_VALID_MASK_PGD;
+  if(harvest.accessed) memset(harvest.accessed, 0, bytes);
+  if(harvest.dirty) memset(harvest.dirty, 0, bytes);
 
+  /* Lock mm */
+  if(lock) lock_mm(mm, 0);
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
-  /* Return p4d offset */
-  entry->p4d = p4d_offset(entry->pgd, addr);
-  if (p4d_none(*(entry->p4d)) || p4d_bad(*(entry->p4d))) {
-    entry->p4d = NULL;
-    goto error_out;
+  walk_page_range_func(mm, request->start, ALIGN(request->end, real_page_size), &harvest_walk_ops, &harvest);
+  /* One deferred flush for all cleared entries */
+  if(harvest.flush_start < harvest.flush_end) {
+    invalidate_range(session, request->pid, mm, harvest.flush_start, harvest.flush_end);
   }
-  entry->valid |= PTEDIT_VALID_MASK_P4D;
 
-  /* Get offset of PUD (page upper directory) */
-  entry->pud = pud_offset(entry->p4d, addr);
-  if (pud_none(*(entry->pud))) {
-    entry->pud = NULL;
-    goto error_out;
-  }
-  entry->valid |= PTEDIT_VALID_MASK_PUD;
+  /* Unlock mm */
+  if(lock) unlock_mm(mm, 0);
+
+  /* The user bitmaps are words with bit i % BITS_PER_LONG of word i / BITS_PER_LONG for page i, the layout of the kernel bitmap on any endianness */
+  if(harvest.accessed && to_user(request->accessed, harvest.accessed, bytes)) ret = -EFAULT;
+  if(harvest.dirty && to_user(request->dirty, harvest.dirty, bytes)) ret = -EFAULT;
+
+out:
+  if(harvest.accessed) batch_free(harvest.accessed);
+  if(harvest.dirty) batch_free(harvest.dirty);
+  return ret;
 #else
-  /* Get offset of PUD (page upper directory) */
-  entry->pud = pud_offset(entry->pgd, addr);
-  if (pud_none(*(entry->pud))) {
-    entry->pud = NULL;
-    goto error_out;
-  }
-  entry->valid |= PTEDIT_VALID_MASK_PUD;
+  return -ENOSYS;
 #endif
+}
 
 
-  /* Get offset of PMD (page middle directory) */
-  entry->pmd = pmd_offset(entry->pud, addr);
-  if (pmd_none(*(entry->pmd)) || pud_large(*(entry->pud))) {
-    entry->pmd = NULL;
-    goto error_out;
-  }
-  entry->valid |= PTEDIT_VALID_MASK_PMD;
+#ifdef HAS_PAGEWALK
+typedef struct {
+  ptedit_bits_t* request;
+  /* Range of modified entries, flushed once after the walk */
+  unsigned long flush_start;
+  unsigned long flush_end;
+} bits_walk_t;
+
+static size_t bits_apply(bits_walk_t* bits, size_t val) {
+  size_t mask = 1ul << bits->request->bit;
+  return bits->request->set ? (val | mask) : (val & ~mask);
+}
 
-  /* Map PTE (page table entry) */
-  entry->pte = pte_offset_map(entry->pmd, addr);
-  if (entry->pte == NULL || pmd_large(*(entry->pmd))) {
-    entry->pte = NULL;
-    goto error_out;
-  }
-  entry->valid |= PTEDIT_VALID_MASK_PTE;
+static void bits_modified(bits_walk_t* bits, unsigned long start, unsigned long end) {
+  if(start < bits->flush_start) bits->flush_start = start;
+  if(end > bits->flush_end) bits->flush_end = end;
+}
 
-  /* Unmap PTE, fine on x86 and ARM64 -> unmap is NOP */
-  pte_unmap(entry->pte);
+static int bits_pud_entry(pud_t *pud, unsigned long addr, unsigned long next, struct mm_walk *walk) {
+  bits_walk_t* bits = (bits_walk_t*)walk->private;
+  pud_t old;
+  pteditor_pudval_t new;
 
-  /* Unlock mm */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-  if(lock) mmap_read_unlock(mm);
-#else
-  if(lock) up_read(&mm->mmap_sem);
-#endif
+  old = READ_ONCE(*pud);
+  if(!pud_present(old)) return 0;
+  if(!pteditor_pud_leaf(old)) {
+    /* Do not walk the lower tables if none of their levels is modified */
+    if(!(bits->request->levels & (PTEDIT_VALID_MASK_PMD | PTEDIT_VALID_MASK_PTE))) walk->action = ACTION_CONTINUE;
+    return 0;
+  }
+  walk->action = ACTION_CONTINUE;
+  if(!(bits->request->levels & PTEDIT_VALID_MASK_PUD)) return 0;
+  /* Atomic with respect to the hardware setting accessed/dirty bits */
+  do {
+    old = READ_ONCE(*pud);
+    if(!pud_present(old) || !pteditor_pud_leaf(old)) return 0;
+    new = bits_apply(bits, pud_val(old));
+    if(new == pud_val(old)) return 0;
+  } while(cmpxchg((pteditor_pudval_t*)pud, pud_val(old), new) != pud_val(old));
+  /* The entire huge page is affected, even if it is only partially in the range */
+  bits_modified(bits, addr & PUD_MASK, (addr & PUD_MASK) + PUD_SIZE);
+  return 0;
+}
 
+static int bits_pmd_entry(pmd_t *pmd, unsigned long addr, unsigned long next, struct mm_walk *walk) {
+  bits_walk_t* bits = (bits_walk_t*)walk->private;
+  spinlock_t *ptl;
+  pmd_t old;
+  pteditor_pmdval_t new;
+  int modified = 0;
+
+  old = READ_ONCE(*pmd);
+  if(!pmd_present(old)) return 0;
+  if(!pteditor_pmd_leaf(old)) {
+    /* Do not walk the page table if the PTE level is not modified */
+    if(!(bits->request->levels & PTEDIT_VALID_MASK_PTE)) walk->action = ACTION_CONTINUE;
+    return 0;
+  }
+  /* Do not descend, otherwise the walker splits the huge page */
+  walk->action = ACTION_CONTINUE;
+  if(!(bits->request->levels & PTEDIT_VALID_MASK_PMD)) return 0;
+  /* Serialized against splits of the huge page, as for harvesting */
+  ptl = pmd_lock(walk->mm, pmd);
+  do {
+    old = READ_ONCE(*pmd);
+    if(!pmd_present(old) || !pteditor_pmd_leaf(old)) break;
+    new = bits_apply(bits, pmd_val(old));
+    if(new == pmd_val(old)) break;
+    modified = cmpxchg((pteditor_pmdval_t*)pmd, pmd_val(old), new) == pmd_val(old);
+  } while(!modified);
+  spin_unlock(ptl);
+  if(modified) bits_modified(bits, addr & PMD_MASK, (addr & PMD_MASK) + PMD_SIZE);
+  /* Split in the meantime, the PTEs might still have to be modified */
+  if(pmd_present(old) && !pteditor_pmd_leaf(old) && (bits->request->levels & PTEDIT_VALID_MASK_PTE)) walk->action = ACTION_SUBTREE;
   return 0;
+}
 
-error_out:
+static int bits_pte_entry(pte_t *pte, unsigned long addr, unsigned long next, struct mm_walk *walk) {
+  bits_walk_t* bits = (bits_walk_t*)walk->private;
+  pte_t old;
+  pteditor_pteval_t new;
+
+  /* Only reached if the PTE level is modified */
+  do {
+    old = READ_ONCE(*pte);
+    if(!pte_present(old)) return 0;
+    new = bits_apply(bits, pte_val(old));
+    if(new == pte_val(old)) return 0;
+  } while(cmpxchg((pteditor_pteval_t*)pte, pte_val(old), new) != pte_val(old));
+  bits_modified(bits, addr, next);
+  return 0;
+}
 
-  /* Unlock mm */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-  if(lock) mmap_read_unlock(mm);
-#else
-  if(lock) up_read(&mm->mmap_sem);
+/* hugetlb mappings are skipped, their entries have to be modified consistently for contiguous mappings */
+static const struct mm_walk_ops bits_walk_ops = {
+  .pud_entry = bits_pud_entry,
+  .pmd_entry = bits_pmd_entry,
+  .pte_entry = bits_pte_entry,
+};
 #endif
 
-  return 1;
-}
-
+static int bits_vm(session_t* session, ptedit_bits_t* request, int lock) {
+#ifdef HAS_PAGEWALK
+  struct mm_struct *mm;
+  bits_walk_t bits;
 
-static int update_vm(ptedit_entry_t* new_entry, int lock) {
-  vm_t old_entry;
-  size_t addr = new_entry->vaddr;
-  struct mm_struct *mm = get_mm(new_entry->pid);
+  if(!walk_page_range_func) return -ENOSYS;
+  if(request->bit >= BITS_PER_LONG) return -EINVAL;
+  if(request->start >= request->end) return 0;
+  mm = session_mm(session, request->pid);
   if(!mm) return 1;
 
-  old_entry.pid = new_entry->pid;
+  bits.request = request;
+  bits.flush_start = ULONG_MAX;
+  bits.flush_end = 0;
 
   /* Lock mm */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-  if(lock) mmap_write_lock(mm);
+  if(lock) lock_mm(mm, 0);
+
+  walk_page_range_func(mm, request->start & ~((size_t)real_page_size - 1), ALIGN(request->end, real_page_size), &bits_walk_ops, &bits);
+  /* One deferred flush for all modified entries */
+  if(bits.flush_start < bits.flush_end) {
+    invalidate_range(session, request->pid, mm, bits.flush_start, bits.flush_end);
+  }
+
+  /* Unlock mm */
+  if(lock) unlock_mm(mm, 0);
+  return 0;
 #else
-  if(lock) down_write(&mm->mmap_sem);
+  return -ENOSYS;
 #endif
+}
 
-  resolve_vm(addr, &old_entry, 0);
+#ifdef HAS_MMU_NOTIFIER
+static void watch_push(session_t* session, size_t event, unsigned long start, unsigned long end) {
+  ptedit_event_t e;
+  unsigned long flags;
 
-  /* Update entries */
-  if((old_entry.valid & PTEDIT_VALID_MASK_PGD) && (new_entry->valid & PTEDIT_VALID_MASK_PGD)) {
-      pr_warn("Updating PGD\n");
-      set_pgd(old_entry.pgd, native_make_pgd(new_entry->pgd));
-  }
+  e.event = event;
+  e.start = start;
+  e.end = end;
+  /* Might be called from non-blocking contexts, only use the spinlock */
+  spin_lock_irqsave(&session->events_lock, flags);
+  if(!kfifo_put(&session->events, e)) session->events_lost = true;
+  spin_unlock_irqrestore(&session->events_lock, flags);
+  wake_up_interruptible(&session->events_wait);
+}
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
-  if((old_entry.valid & PTEDIT_VALID_MASK_P4D) && (new_entry->valid & PTEDIT_VALID_MASK_P4D)) {
-      pr_warn("Updating P4D\n");
-      set_p4d(old_entry.p4d, native_make_p4d(new_entry->p4d));
-  }
-#endif
+static void watch_invalidate_range_end(struct mmu_notifier *mn, const struct mmu_notifier_range *range) {
+  session_t* session = container_of(mn, session_t, notifier);
+  /* Reported after the change, entries resolved after reading the event are up to date */
+  if(range->end <= session->watch_start || range->start >= session->watch_end) return;
+  watch_push(session, PTEDIT_EVENT_INVALIDATE, max(range->start, session->watch_start), min(range->end, session->watch_end));
+}
 
-  if((old_entry.valid & PTEDIT_VALID_MASK_PUD) && (new_entry->valid & PTEDIT_VALID_MASK_PUD)) {
-      pr_warn("Updating PUD\n");
-      set_pud(old_entry.pud, native_make_pud(new_entry->pud));
-  }
+static void watch_release(struct mmu_notifier *mn, struct mm_struct *mm) {
+  session_t* session = container_of(mn, session_t, notifier);
+  watch_push(session, PTEDIT_EVENT_RELEASE, session->watch_start, session->watch_end);
+}
 
-  if((old_entry.valid & PTEDIT_VALID_MASK_PMD) && (new_entry->valid & PTEDIT_VALID_MASK_PMD)) {
-      pr_warn("Updating PMD\n");
-      set_pmd(old_entry.pmd, native_make_pmd(new_entry->pmd));
+static const struct mmu_notifier_ops watch_ops = {
+  .invalidate_range_end = watch_invalidate_range_end,
+  .release = watch_release,
+};
+
+static void unwatch_vm(session_t* session) {
+  if(!session->watched_mm) return;
+  mmu_notifier_unregister(&session->notifier, session->watched_mm);
+  mmdrop(session->watched_mm);
+  session->watched_mm = NULL;
+}
+
+static int watch_vm(session_t* session, ptedit_range_t* range) {
+  struct mm_struct *mm;
+  int ret;
+
+  if(range->start >= range->end) return -EINVAL;
+  if(session->mm_is_locked) return -EBUSY;
+  unwatch_vm(session);
+
+  mm = session_mm(session, range->pid);
+  if(!mm || !mmget_not_zero(mm)) return 1;
+  session->watch_start = range->start;
+  session->watch_end = range->end;
+  session->notifier.ops = &watch_ops;
+  ret = mmu_notifier_register(&session->notifier, mm);
+  if(!ret) {
+    mmgrab(mm);
+    session->watched_mm = mm;
   }
+  mmput(mm);
+  return ret;
+}
 
-  if((old_entry.valid & PTEDIT_VALID_MASK_PTE) && (new_entry->valid & PTEDIT_VALID_MASK_PTE)) {
-      pr_warn("Updating PTE\n");
-      set_pte(old_entry.pte, native_make_pte(new_entry->pte));
+static ssize_t device_read(struct file *file, char __user *buf, size_t count, loff_t *ppos) {
+  session_t* session = (session_t*)file->private_data;
+  ptedit_event_t events[16];
+  size_t n = 0, max_events = min_t(size_t, count / sizeof(ptedit_event_t), ARRAY_SIZE(events));
+  unsigned long flags;
+  int ret;
+
+  if(!max_events) return -EINVAL;
+  while(1) {
+    spin_lock_irqsave(&session->events_lock, flags);
+    if(session->events_lost) {
+      /* Replace the queued events, the client has to drop everything anyway */
+      kfifo_reset(&session->events);
+      session->events_lost = false;
+      events[0].event = PTEDIT_EVENT_OVERFLOW;
+      events[0].start = session->watch_start;
+      events[0].end = session->watch_end;
+      n = 1;
+    } else {
+      n = kfifo_out(&session->events, events, max_events);
+    }
+    spin_unlock_irqrestore(&session->events_lock, flags);
+    if(n) break;
+    if(file->f_flags & O_NONBLOCK) return -EAGAIN;
+    ret = wait_event_interruptible(session->events_wait, !kfifo_is_empty(&session->events) || session->events_lost);
+    if(ret) return ret;
   }
+  if(to_user(buf, events, n * sizeof(ptedit_event_t))) return -EFAULT;
+  return n * sizeof(ptedit_event_t);
+}
 
-  invalidate_tlb(addr);
+static __poll_t device_poll(struct file *file, poll_table *wait) {
+  session_t* session = (session_t*)file->private_data;
+  poll_wait(file, &session->events_wait, wait);
+  if(!kfifo_is_empty(&session->events) || session->events_lost) return EPOLLIN | EPOLLRDNORM;
+  return 0;
+}
+#endif
 
-  /* Unlock mm */
+static void unlock_session_mm(session_t* session) {
+  struct mm_struct *mm = session->locked_mm;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-  if(lock) mmap_write_unlock(mm);
+  mmap_write_unlock(mm);
+  mmap_read_unlock(mm);
 #else
-  if(lock) up_write(&mm->mmap_sem);
+  up_write(&mm->mmap_sem);
+  up_read(&mm->mmap_sem);
 #endif
+  session->mm_is_locked = false;
+  session->locked_mm = NULL;
+  mmdrop(mm);
+}
 
-  return 0;
+static void detach_vm(session_t* session) {
+  if(!session->target_mm) return;
+  mmput(session->target_mm);
+  session->target_mm = NULL;
 }
 
+static int attach_vm(session_t* session, ptedit_attach_t* attach) {
+  struct task_struct *task;
+  struct pid *pid;
+  struct mm_struct *mm;
 
-static void vm_to_user(ptedit_entry_t* user, vm_t* vm) {
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
-#if CONFIG_PGTABLE_LEVELS > 4
-    if(vm->p4d) user->p4d = (vm->p4d)->p4d;
-#else
-#if !defined(__ARCH_HAS_5LEVEL_HACK)
-    if(vm->p4d) user->p4d = (vm->p4d)->pgd.pgd;
+  if(session->mm_is_locked) return -EBUSY;
+  detach_vm(session);
+
+  if(attach->pidfd >= 0) {
+#ifdef HAS_PIDFD
+    struct file *file;
+    if(!pidfd_pid_func) return -ENOSYS;
+    file = fget(attach->pidfd);
+    if(!file) return -EBADF;
+    /* The pid is only referenced by the file */
+    pid = pidfd_pid_func(file);
+    task = IS_ERR(pid) ? NULL : get_pid_task(pid, PIDTYPE_PID);
+    fput(file);
+    if(IS_ERR(pid)) return PTR_ERR(pid);
 #else
-    if(vm->p4d) user->p4d = (vm->p4d)->pgd;    
-#endif
+    return -ENOSYS;
 #endif
+  } else if(attach->pid) {
+    pid = find_get_pid(attach->pid);
+    if(!pid) return -ESRCH;
+    task = get_pid_task(pid, PIDTYPE_PID);
+    put_pid(pid);
+  } else {
+    task = current;
+    get_task_struct(task);
+  }
+  if(!task) return -ESRCH;
+
+  /* Pins the address space, it stays valid even if the process exits */
+  mm = get_task_mm(task);
+  attach->pid = task_pid_vnr(task);
+  put_task_struct(task);
+  if(!mm) return -EINVAL;
+
+  session->target_mm = mm;
+  return 0;
+}
+
+static int device_open(struct inode *inode, struct file *file) {
+  session_t* session = kzalloc(sizeof(session_t), GFP_KERNEL);
+  if (!session) {
+    return -ENOMEM;
+  }
+
+  session->invalidate_tlb = invalidate_tlb_kernel;
+  session->invalidate_tlb_range = invalidate_tlb_kernel_range;
+#ifdef HAS_MMU_NOTIFIER
+  INIT_KFIFO(session->events);
+  spin_lock_init(&session->events_lock);
+  init_waitqueue_head(&session->events_wait);
 #endif
-#if defined(__i386__) || defined(__x86_64__)
-    if(vm->pgd) user->pgd = (vm->pgd)->pgd;
-    if(vm->pmd) user->pmd = (vm->pmd)->pmd;
-    if(vm->pud) user->pud = (vm->pud)->pud;
-    if(vm->pte) user->pte = (vm->pte)->pte;
-#elif defined(__aarch64__)
-    if(vm->pgd) user->pgd = pgd_val(*(vm->pgd));
-    if(vm->pmd) user->pmd = pmd_val(*(vm->pmd));
-    if(vm->pud) user->pud = pud_val(*(vm->pud));
-    if(vm->pte) user->pte = pte_val(*(vm->pte));
+  file->private_data = session;
+
+  return 0;
+}
+
+static int device_release(struct inode *inode, struct file *file) {
+  session_t* session = (session_t*)file->private_data;
+
+  /* Do not leave the mm locked if the client closes the file without unlocking it.
+   * This does not help if the locking process exits: exit_mm() waits for the mmap lock
+   * before the file is released, so the process hangs until another holder of the file closes it. */
+  if (session->mm_is_locked) unlock_session_mm(session);
+#ifdef HAS_MMU_NOTIFIER
+  unwatch_vm(session);
 #endif
-    user->valid = vm->valid;
+  detach_vm(session);
+  kfree(session);
+
+  return 0;
 }
 
+static long device_ioctl_cmd(struct file *file, unsigned int ioctl_num, unsigned long ioctl_param) {
+  session_t* session = (session_t*)file->private_data;
 
-static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned long ioctl_param) {
   switch (ioctl_num) {
     case PTEDITOR_IOCTL_CMD_VM_RESOLVE:
     {
@@ -457,22 +1726,88 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
         vm_t vm;
         (void)from_user(&vm_user, (void*)ioctl_param, sizeof(vm_user));
         vm.pid = vm_user.pid;
-        resolve_vm(vm_user.vaddr, &vm, !mm_is_locked);
+        resolve_vm(session, vm_user.vaddr, &vm, !session->mm_is_locked);
         vm_to_user(&vm_user, &vm);
         (void)to_user((void*)ioctl_param, &vm_user, sizeof(vm_user));
         return 0;
     }
+    case PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH:
+    {
+        ptedit_batch_t batch;
+        if(from_user(&batch, (void*)ioctl_param, sizeof(batch))) return -EFAULT;
+        return resolve_vm_batch(session, &batch, !session->mm_is_locked);
+    }
     case PTEDITOR_IOCTL_CMD_VM_UPDATE:
     {
         ptedit_entry_t vm_user;
         (void)from_user(&vm_user, (void*)ioctl_param, sizeof(vm_user));
-        update_vm(&vm_user, !mm_is_locked);
+        update_vm(session, &vm_user, !session->mm_is_locked);
+        return 0;
+    }
+    case PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH:
+    {
+        ptedit_batch_t batch;
+        if(from_user(&batch, (void*)ioctl_param, sizeof(batch))) return -EFAULT;
+        return update_vm_batch(session, &batch, !session->mm_is_locked);
+    }
+    case PTEDITOR_IOCTL_CMD_VM_DUMP:
+    {
+        ptedit_range_t range;
+        int ret;
+        if(from_user(&range, (void*)ioctl_param, sizeof(range))) return -EFAULT;
+        ret = dump_vm(session, &range, !session->mm_is_locked);
+        if(ret) return ret;
+        (void)to_user((void*)ioctl_param, &range, sizeof(range));
+        return 0;
+    }
+    case PTEDITOR_IOCTL_CMD_VM_HARVEST:
+    {
+        ptedit_harvest_t harvest;
+        if(from_user(&harvest, (void*)ioctl_param, sizeof(harvest))) return -EFAULT;
+        return harvest_vm(session, &harvest, !session->mm_is_locked);
+    }
+    case PTEDITOR_IOCTL_CMD_VM_BITS:
+    {
+        ptedit_bits_t bits;
+        if(from_user(&bits, (void*)ioctl_param, sizeof(bits))) return -EFAULT;
+        return bits_vm(session, &bits, !session->mm_is_locked);
+    }
+    case PTEDITOR_IOCTL_CMD_WATCH:
+    {
+#ifdef HAS_MMU_NOTIFIER
+        ptedit_range_t range;
+        if(from_user(&range, (void*)ioctl_param, sizeof(range))) return -EFAULT;
+        return watch_vm(session, &range);
+#else
+        return -ENOSYS;
+#endif
+    }
+    case PTEDITOR_IOCTL_CMD_UNWATCH:
+    {
+#ifdef HAS_MMU_NOTIFIER
+        unwatch_vm(session);
+        return 0;
+#else
+        return -ENOSYS;
+#endif
+    }
+    case PTEDITOR_IOCTL_CMD_ATTACH:
+    {
+        ptedit_attach_t attach;
+        int ret;
+        if(from_user(&attach, (void*)ioctl_param, sizeof(attach))) return -EFAULT;
+        ret = attach_vm(session, &attach);
+        if(ret) return ret;
+        (void)to_user((void*)ioctl_param, &attach, sizeof(attach));
         return 0;
     }
+    case PTEDITOR_IOCTL_CMD_DETACH:
+        detach_vm(session);
+        return 0;
     case PTEDITOR_IOCTL_CMD_VM_LOCK:
     {
         struct mm_struct *mm = current->active_mm;
-        if(mm_is_locked) {
+        if(session->mm_is_locked) {
             pr_warn("VM is already locked\n");
             return -1;
         }
@@ -483,26 +1818,22 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
         down_write(&mm->mmap_sem);
         down_read(&mm->mmap_sem);
 #endif
-        mm_is_locked = true;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+        mmgrab(mm);
+#else
+        atomic_inc(&mm->mm_count);
+#endif
+        session->mm_is_locked = true;
+        session->locked_mm = mm;
         return 0;
     }
     case PTEDITOR_IOCTL_CMD_VM_UNLOCK:
-    {
-        struct mm_struct *mm = current->active_mm;
-        if(!mm_is_locked) {
+        if(!session->mm_is_locked) {
             pr_warn("VM is not locked\n");
             return -1;
         }
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-        mmap_write_unlock(mm);
-        mmap_read_unlock(mm);
-#else
-        up_write(&mm->mmap_sem);
-        up_read(&mm->mmap_sem);
-#endif
-        mm_is_locked = false;
+        unlock_session_mm(session);
         return 0;
-    }
     case PTEDITOR_IOCTL_CMD_READ_PAGE:
     {
         ptedit_page_t page;
@@ -517,13 +1848,25 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
         (void)from_user(phys_to_virt(page.pfn * real_page_size), page.buffer, real_page_size);
         return 0;
     }
+    case PTEDITOR_IOCTL_CMD_READ_PAGES:
+    {
+        ptedit_batch_t batch;
+        if(from_user(&batch, (void*)ioctl_param, sizeof(batch))) return -EFAULT;
+        return copy_pages(&batch, 0);
+    }
+    case PTEDITOR_IOCTL_CMD_WRITE_PAGES:
+    {
+        ptedit_batch_t batch;
+        if(from_user(&batch, (void*)ioctl_param, sizeof(batch))) return -EFAULT;
+        return copy_pages(&batch, 1);
+    }
     case PTEDITOR_IOCTL_CMD_GET_ROOT:
     {
         struct mm_struct *mm;
         ptedit_paging_t paging;
 
         (void)from_user(&paging, (void*)ioctl_param, sizeof(paging));
-        mm = get_mm(paging.pid);
+        mm = session_mm(session, paging.pid);
 
 #if defined(__aarch64__)
         if(!mm || (mm && !mm->pgd)) {
@@ -533,20 +1876,19 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
             (void)to_user((void*)ioctl_param, &paging, sizeof(paging));
             return 0;
         }
+#elif defined(__riscv)
+        if(!mm || (mm && !mm->pgd)) {
+            /* Only works for the current process, the PPN of satp is the root (mode and ASID are masked) */
+            paging.root = (csr_read(CSR_SATP) & ((1ull << 44) - 1)) << 12;
+            (void)to_user((void*)ioctl_param, &paging, sizeof(paging));
+            return 0;
+        }
 #endif
 
         if(!mm) return 1;
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-        if(!mm_is_locked) mmap_read_lock(mm);
-#else
-        if(!mm_is_locked) down_read(&mm->mmap_sem);
-#endif
+        if(!session->mm_is_locked) lock_mm(mm, 0);
         paging.root = virt_to_phys(mm->pgd);
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-        if(!mm_is_locked) mmap_read_unlock(mm);
-#else
-        if(!mm_is_locked) up_read(&mm->mmap_sem);
-#endif
+        if(!session->mm_is_locked) unlock_mm(mm, 0);
         (void)to_user((void*)ioctl_param, &paging, sizeof(paging));
         return 0;
     }
@@ -556,26 +1898,33 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
         ptedit_paging_t paging = {0};
 
         (void)from_user(&paging, (void*)ioctl_param, sizeof(paging));
-        mm = get_mm(paging.pid);
+        mm = session_mm(session, paging.pid);
         if(!mm) return 1;
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-        if(!mm_is_locked) mmap_write_lock(mm);
-#else
-        if(!mm_is_locked) down_write(&mm->mmap_sem);
-#endif
+        if(!session->mm_is_locked) lock_mm(mm, 1);
         mm->pgd = (pgd_t*)phys_to_virt(paging.root);
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
-        if(!mm_is_locked) mmap_write_unlock(mm);
-#else
-        if(!mm_is_locked) up_write(&mm->mmap_sem);
-#endif
+        if(!session->mm_is_locked) unlock_mm(mm, 1);
         return 0;
     }
     case PTEDITOR_IOCTL_CMD_GET_PAGESIZE:
         return real_page_size;
+    case PTEDITOR_IOCTL_CMD_GET_PAGING_LEVELS:
+        return paging_levels();
     case PTEDITOR_IOCTL_CMD_INVALIDATE_TLB:
-        invalidate_tlb(ioctl_param);
+        invalidate(session, 0, ioctl_param);
+        return 0;
+    case PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_RANGE:
+    {
+        ptedit_range_t range;
+        struct mm_struct *mm;
+        if(from_user(&range, (void*)ioctl_param, sizeof(range))) return -EFAULT;
+        mm = session_mm(session, range.pid);
+        if(!mm) return 1;
+        if(range.start >= range.end) return 0;
+        if(!session->mm_is_locked) lock_mm(mm, 0);
+        invalidate_range(session, range.pid, mm, range.start & ~((size_t)real_page_size - 1), ALIGN(range.end, real_page_size));
+        if(!session->mm_is_locked) unlock_mm(mm, 0);
         return 0;
+    }
     case PTEDITOR_IOCTL_CMD_GET_PAT:
     {
 #if defined(__i386__) || defined(__x86_64__)
@@ -590,6 +1939,11 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
         asm volatile ("mrs %0, mair_el1\n" : "=r"(value));
         (void)to_user((void*)ioctl_param, &value, sizeof(value));
         return 0;
+#elif defined(__riscv)
+        /* Fixed mapping, memory type i is the Svpbmt value i (PMA, NC, IO) */
+        size_t value = 0x020100;
+        (void)to_user((void*)ioctl_param, &value, sizeof(value));
+        return 0;
 #endif
     }
     case PTEDITOR_IOCTL_CMD_SET_PAT:
@@ -597,12 +1951,38 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
         set_pat(ioctl_param);
         return 0;
     }
+    case PTEDITOR_IOCTL_CMD_GET_STATS:
+    {
+        ptedit_stats_t* stats = kmalloc(sizeof(ptedit_stats_t), GFP_KERNEL);
+        int ret = 0;
+        if(!stats) return -ENOMEM;
+        stats_sum(stats);
+        if(to_user((void*)ioctl_param, stats, sizeof(ptedit_stats_t))) ret = -EFAULT;
+        kfree(stats);
+        return ret;
+    }
     case PTEDITOR_IOCTL_CMD_SWITCH_TLB_INVALIDATION:
     {
-      if((int)ioctl_param != PTEDITOR_TLB_INVALIDATION_KERNEL && (int)ioctl_param != PTEDITOR_TLB_INVALIDATION_CUSTOM)
-        return -1;
-      invalidate_tlb = ((int)ioctl_param == PTEDITOR_TLB_INVALIDATION_KERNEL) ? invalidate_tlb_kernel : invalidate_tlb_custom;
-      return 0;
+      switch((int)ioctl_param) {
+        case PTEDITOR_TLB_INVALIDATION_KERNEL:
+          session->invalidate_tlb = invalidate_tlb_kernel;
+          session->invalidate_tlb_range = invalidate_tlb_kernel_range;
+          return 0;
+        case PTEDITOR_TLB_INVALIDATION_CUSTOM:
+          session->invalidate_tlb = invalidate_tlb_custom;
+          session->invalidate_tlb_range = invalidate_tlb_custom_range;
+          return 0;
+        case PTEDITOR_TLB_INVALIDATION_CUSTOM_PCID:
+          session->invalidate_tlb = invalidate_tlb_pcid;
+          session->invalidate_tlb_range = invalidate_tlb_pcid_range;
+          return 0;
+        case PTEDITOR_TLB_INVALIDATION_CUSTOM_CPUMASK:
+          session->invalidate_tlb = invalidate_tlb_cpumask;
+          session->invalidate_tlb_range = invalidate_tlb_cpumask_range;
+          return 0;
+        default:
+          return -1;
+      }
     }
 
     default:
@@ -612,8 +1992,100 @@ static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned lon
   return 0;
 }
 
+static long device_ioctl(struct file *file, unsigned int ioctl_num, unsigned long ioctl_param) {
+  u64 start = local_clock();
+  long ret = device_ioctl_cmd(file, ioctl_num, ioctl_param);
+  stat_record(&pteditor_stats->commands[PTEDIT_STATS_INDEX(_IOC_NR(ioctl_num))], local_clock() - start);
+  return ret;
+}
+
+static int stats_show(struct seq_file *m, void *v) {
+  ptedit_stats_t* stats = kmalloc(sizeof(ptedit_stats_t), GFP_KERNEL);
+  ptedit_stat_t* stat;
+  size_t i, j;
+  if(!stats) return -ENOMEM;
+  stats_sum(stats);
+  for(i = 0; i < PTEDIT_STATS_COMMANDS + 2; i++) {
+    if(i < PTEDIT_STATS_COMMANDS) {
+      stat = &stats->commands[i];
+      if(!stat->count) continue;
+      seq_printf(m, "cmd%-3zu", i);
+    } else {
+      stat = (i == PTEDIT_STATS_COMMANDS) ? &stats->lock : &stats->flush;
+      seq_printf(m, "%-6s", (i == PTEDIT_STATS_COMMANDS) ? "lock" : "flush");
+    }
+    seq_printf(m, " count %zu total_ns %zu histogram", stat->count, stat->total_ns);
+    for(j = 0; j < PTEDIT_STATS_BUCKETS; j++) seq_printf(m, " %zu", stat->histogram[j]);
+    seq_putc(m, '\n');
+  }
+  kfree(stats);
+  return 0;
+}
+
+static int stats_open(struct inode *inode, struct file *file) {
+  return single_open(file, stats_show, NULL);
+}
+
+static const struct file_operations stats_fops = {
+  .owner = THIS_MODULE,
+  .open = stats_open,
+  .read = seq_read,
+  .llseek = seq_lseek,
+  .release = single_release,
+};
+
+static ssize_t reset_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos) {
+  stats_reset();
+  return count;
+}
+
+static const struct file_operations reset_fops = {
+  .owner = THIS_MODULE,
+  .write = reset_write,
+};
+
+#ifdef HAS_URING_CMD
+static int device_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags) {
+  const size_t *param;
+
+  /* Only stateless commands, the same parameter as for the ioctl is stored in the command area of the SQE */
+  switch(ioucmd->cmd_op) {
+    case PTEDITOR_IOCTL_CMD_VM_RESOLVE:
+    case PTEDITOR_IOCTL_CMD_VM_UPDATE:
+    case PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH:
+    case PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH:
+    case PTEDITOR_IOCTL_CMD_READ_PAGE:
+    case PTEDITOR_IOCTL_CMD_WRITE_PAGE:
+    case PTEDITOR_IOCTL_CMD_READ_PAGES:
+    case PTEDITOR_IOCTL_CMD_WRITE_PAGES:
+    case PTEDITOR_IOCTL_CMD_INVALIDATE_TLB:
+    case PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_RANGE:
+      break;
+    default:
+      return -EOPNOTSUPP;
+  }
+
+  /* The commands sleep on the mmap lock, let the io_uring worker (which shares the mm of the submitter) execute them */
+  if(issue_flags & IO_URING_F_NONBLOCK) return -EAGAIN;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+  param = io_uring_sqe_cmd(ioucmd->sqe);
+#else
+  param = ioucmd->cmd;
+#endif
+  return (int)device_ioctl(ioucmd->file, ioucmd->cmd_op, param[0]);
+}
+#endif
+
 static struct file_operations f_ops = {.owner = THIS_MODULE,
                                        .unlocked_ioctl = device_ioctl,
+#ifdef HAS_URING_CMD
+                                       .uring_cmd = device_uring_cmd,
+#endif
+#ifdef HAS_MMU_NOTIFIER
+                                       .read = device_read,
+                                       .poll = device_poll,
+#endif
                                        .open = device_open,
                                        .release = device_release};
 
@@ -662,6 +2134,10 @@ static int devmem_bypass(struct kretprobe_instance *p, struct pt_regs *regs) {
   if (regs->regs[0] == 0) {
     regs->regs[0] = 1;
   }
+#elif defined(__riscv)
+  if (regs->a0 == 0) {
+    regs->a0 = 1;
+  }
 #else
   if (regs->ax == 0) {
     regs->ax = 1;
@@ -672,6 +2148,13 @@ static int devmem_bypass(struct kretprobe_instance *p, struct pt_regs *regs) {
 
 static struct kretprobe probe_devmem = {.handler = devmem_bypass, .maxactive = 20};
 
+/* Undoes the registration and allocation if a later step of the initialization fails */
+static int __init __maybe_unused pteditor_init_failed(void) {
+  misc_deregister(&misc_dev);
+  free_percpu(pteditor_stats);
+  return -ENXIO;
+}
+
 static int __init pteditor_init(void) {
   int r;
 #if defined(__aarch64__)
@@ -689,10 +2172,17 @@ static int __init pteditor_init(void) {
     }
 #endif
 
+  pteditor_stats = alloc_percpu(ptedit_stats_t);
+  if(!pteditor_stats) {
+    pr_alert("Could not allocate statistics\n");
+    return -ENOMEM;
+  }
+
   /* Register device */
   r = misc_register(&misc_dev);
   if (r != 0) {
     pr_alert("Failed registering device with %d\n", r);
+    free_percpu(pteditor_stats);
     return -ENXIO;
   }
 
@@ -700,17 +2190,47 @@ static int __init pteditor_init(void) {
   flush_tlb_mm_range_func = (void *) kallsyms_lookup_name("flush_tlb_mm_range");
   if(!flush_tlb_mm_range_func) {
     pr_alert("Could not retrieve flush_tlb_mm_range function\n");
-    return -ENXIO;
+    return pteditor_init_failed();
+  }
+#elif defined(__riscv)
+#ifdef HAS_RISCV_ASID_FENCE
+  asid_mask_ptr = (void *) kallsyms_lookup_name("asid_mask");
+  if(!asid_mask_ptr) {
+    pr_warn("Could not retrieve asid_mask, custom TLB invalidation flushes all ASIDs\n");
+  }
+#endif
+  flush_tlb_range_func = (void *) kallsyms_lookup_name("flush_tlb_range");
+  flush_tlb_mm_func = (void *) kallsyms_lookup_name("flush_tlb_mm");
+  if(!flush_tlb_range_func || !flush_tlb_mm_func) {
+    pr_alert("Could not retrieve flush_tlb_range/flush_tlb_mm functions\n");
+    return pteditor_init_failed();
+  }
+#endif
+#ifdef HAS_PCID_TRACKING
+  cpu_tlbstate_ptr = (void *) kallsyms_lookup_name("cpu_tlbstate");
+  if(!cpu_tlbstate_ptr) {
+    pr_warn("Could not retrieve cpu_tlbstate, PCID-aware TLB invalidation flushes all PCIDs\n");
+  }
+#endif
+#ifdef HAS_PAGEWALK
+  walk_page_range_func = (void *) kallsyms_lookup_name("walk_page_range");
+  if(!walk_page_range_func) {
+    pr_warn("Could not retrieve walk_page_range function, range dumps are not supported\n");
+  }
+#endif
+#ifdef HAS_PIDFD
+  pidfd_pid_func = (void *) kallsyms_lookup_name("pidfd_pid");
+  if(!pidfd_pid_func) {
+    pr_warn("Could not retrieve pidfd_pid function, attaching by pidfd is not supported\n");
   }
 #endif
-  invalidate_tlb = invalidate_tlb_kernel;
   
 #if defined(__i386__) || defined(__x86_64__)
   if (!cpu_feature_enabled(X86_FEATURE_INVPCID_SINGLE)) {
     native_write_cr4_func = (void *) kallsyms_lookup_name("native_write_cr4");
     if(!native_write_cr4_func) {
         pr_alert("Could not retrieve native_write_cr4 function\n");
-        return -ENXIO;
+        return pteditor_init_failed();
     }
   }
 #endif
@@ -755,6 +2275,11 @@ static int __init pteditor_init(void) {
     pr_info("Unprivileged memory access via /proc/umem set up\n");
     has_umem = 1;
   }
+  debugfs_dir = debugfs_create_dir("pteditor", NULL);
+  if(!IS_ERR_OR_NULL(debugfs_dir)) {
+    debugfs_create_file("stats", 0444, debugfs_dir, NULL, &stats_fops);
+    debugfs_create_file("reset", 0200, debugfs_dir, NULL, &reset_fops);
+  }
   pr_info("Loaded.\n");
 
   return 0;
@@ -762,6 +2287,7 @@ static int __init pteditor_init(void) {
 
 static void __exit pteditor_exit(void) {
   misc_deregister(&misc_dev);
+  debugfs_remove_recursive(debugfs_dir);
   
   unregister_kretprobe(&probe_devmem);
 
@@ -769,6 +2295,7 @@ static void __exit pteditor_exit(void) {
     pr_info("Remove unprivileged memory access\n");
     remove_proc_entry("umem", NULL);
   }
+  free_percpu(pteditor_stats);
   pr_info("Removed.\n");
 }
 
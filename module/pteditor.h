@@ -54,6 +54,10 @@ typedef struct {
     size_t pte;
     /** Bitmask indicating which entries are valid/should be updated */
     size_t valid;
+    /** Level of the leaf entry mapping the address (one of PTEDIT_VALID_MASK_*, 0 if the walk ended before a leaf) */
+    size_t level;
+    /** Number of bytes mapped by the leaf entry (e.g., 4 KB, 2 MB, or 1 GB), 0 if the walk ended before a leaf */
+    size_t page_size;
 } ptedit_entry_t;
 
 /**
@@ -65,7 +69,7 @@ typedef struct {
     size_t pfn;
     /** Virtual address */
     size_t vaddr;
-    /** Page size */
+    /** Page size (number of bytes to copy for multi-page requests, 0 for one page) */
     size_t size;
     /** Page content */
     unsigned char* buffer;
@@ -90,6 +94,148 @@ typedef struct {
     size_t root;
 } ptedit_paging_t;
 
+/**
+ * Structure to attach a session to a process
+ */
+typedef struct {
+    /** Process id, only used if pidfd is negative (0 for own process), set to the process id of the pidfd */
+    size_t pid;
+    /** Pidfd of the process, or -1 to use the process id */
+    int pidfd;
+} ptedit_attach_t;
+
+/**
+ * Structure to pass multiple elements to the kernel with a single request
+ */
+typedef struct {
+    /** Process id */
+    size_t pid;
+    /** Number of elements */
+    size_t count;
+    /** Elements (e.g., ptedit_entry_t) */
+    void* data;
+} ptedit_batch_t;
+
+/**
+ * Structure describing a present leaf entry, i.e., an entry which maps a page
+ */
+typedef struct {
+    /** Virtual address of the mapping */
+    size_t vaddr;
+    /** Value of the leaf entry */
+    size_t entry;
+    /** Level of the leaf entry (one of PTEDIT_VALID_MASK_*) */
+    size_t level;
+    /** Size of the mapping in bytes */
+    size_t size;
+} ptedit_leaf_t;
+
+/**
+ * Structure describing a virtual address range of a process, e.g., to dump its leaf entries or to invalidate it in the TLB
+ */
+typedef struct {
+    /** Process id */
+    size_t pid;
+    /** Start of the range, updated to the address where a subsequent dump has to continue */
+    size_t start;
+    /** End of the range (exclusive) */
+    size_t end;
+    /** Number of leaves the buffer can hold, updated to the number of leaves written (dump only) */
+    size_t count;
+    /** Buffer for the leaves (dump only) */
+    ptedit_leaf_t* leaves;
+} ptedit_range_t;
+
+/** Clear the accessed bits while harvesting */
+#define PTEDIT_HARVEST_CLEAR_ACCESSED (1<<0)
+/** Clear the dirty bits while harvesting */
+#define PTEDIT_HARVEST_CLEAR_DIRTY (1<<1)
+
+/**
+ * Structure to harvest the accessed and dirty bits of a virtual address range
+ */
+typedef struct {
+    /** Process id */
+    size_t pid;
+    /** Start of the range (page aligned) */
+    size_t start;
+    /** End of the range (exclusive) */
+    size_t end;
+    /** Combination of PTEDIT_HARVEST_CLEAR_* */
+    size_t flags;
+    /** Bitmap with one bit per page of the range (bit i % 64 of word i / 64 for page i), can be NULL */
+    size_t* accessed;
+    /** Bitmap with one bit per page of the range (bit i % 64 of word i / 64 for page i), can be NULL */
+    size_t* dirty;
+} ptedit_harvest_t;
+
+/**
+ * Structure to set or clear a bit in all leaf entries of a virtual address range
+ */
+typedef struct {
+    /** Process id */
+    size_t pid;
+    /** Start of the range */
+    size_t start;
+    /** End of the range (exclusive) */
+    size_t end;
+    /** The bit to modify (one of PTEDIT_PAGE_BIT_*) */
+    size_t bit;
+    /** 1 to set the bit, 0 to clear it */
+    size_t set;
+    /** Levels of the leaf entries to modify, combination of PTEDIT_VALID_MASK_PTE, PTEDIT_VALID_MASK_PMD, and PTEDIT_VALID_MASK_PUD */
+    size_t levels;
+} ptedit_bits_t;
+
+/** Page-table entries of the range were invalidated (e.g., unmapped, migrated, or copied on write) */
+#define PTEDIT_EVENT_INVALIDATE 1
+/** The address space of the watched process was torn down */
+#define PTEDIT_EVENT_RELEASE 2
+/** Events were dropped, all cached entries of the watched range are stale */
+#define PTEDIT_EVENT_OVERFLOW 3
+
+/**
+ * Change of the page tables in a watched range, read from the device
+ */
+typedef struct {
+    /** One of PTEDIT_EVENT_* */
+    size_t event;
+    /** Start of the affected range */
+    size_t start;
+    /** End of the affected range (exclusive) */
+    size_t end;
+} ptedit_event_t;
+
+/** Number of log2 latency buckets, bucket i counts latencies in [2^(i-1), 2^i) ns */
+#define PTEDIT_STATS_BUCKETS 32
+/** Number of commands with statistics, indexed by the ioctl number (PTEDIT_STATS_INDEX) */
+#define PTEDIT_STATS_COMMANDS 64
+#define PTEDIT_STATS_INDEX(cmd) ((cmd) & (PTEDIT_STATS_COMMANDS - 1))
+
+/**
+ * Counter and latency histogram of one operation
+ */
+typedef struct {
+    /** Number of operations */
+    size_t count;
+    /** Accumulated latency in ns */
+    size_t total_ns;
+    /** Log2 histogram of the latency in ns */
+    size_t histogram[PTEDIT_STATS_BUCKETS];
+} ptedit_stat_t;
+
+/**
+ * Statistics of the kernel module
+ */
+typedef struct {
+    /** Calls and latency per command, indexed by PTEDIT_STATS_INDEX of the ioctl */
+    ptedit_stat_t commands[PTEDIT_STATS_COMMANDS];
+    /** Acquisitions of the mmap lock and the time waited for it */
+    ptedit_stat_t lock;
+    /** TLB invalidations (single address and range) and their latency */
+    ptedit_stat_t flush;
+} ptedit_stats_t;
+
 #define PTEDIT_VALID_MASK_PGD (1<<0)
 #define PTEDIT_VALID_MASK_P4D (1<<1)
 #define PTEDIT_VALID_MASK_PUD (1<<2)
@@ -98,6 +244,8 @@ typedef struct {
 
 #define PTEDITOR_TLB_INVALIDATION_KERNEL 0
 #define PTEDITOR_TLB_INVALIDATION_CUSTOM 1
+#define PTEDITOR_TLB_INVALIDATION_CUSTOM_PCID 2
+#define PTEDITOR_TLB_INVALIDATION_CUSTOM_CPUMASK 3
 
 #if defined(LINUX)
 #define PTEDITOR_IOCTL_MAGIC_NUMBER (long)0x3d17
@@ -140,6 +288,48 @@ typedef struct {
 
 #define PTEDITOR_IOCTL_CMD_SWITCH_TLB_INVALIDATION \
   _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 13, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 14, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 15, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_DUMP \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 16, size_t)
+
+#define PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_RANGE \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 17, size_t)
+
+#define PTEDITOR_IOCTL_CMD_READ_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 18, size_t)
+
+#define PTEDITOR_IOCTL_CMD_WRITE_PAGES \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 19, size_t)
+
+#define PTEDITOR_IOCTL_CMD_GET_STATS \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 20, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_HARVEST \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 21, size_t)
+
+#define PTEDITOR_IOCTL_CMD_WATCH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 22, size_t)
+
+#define PTEDITOR_IOCTL_CMD_UNWATCH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 23, size_t)
+
+#define PTEDITOR_IOCTL_CMD_ATTACH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 24, size_t)
+
+#define PTEDITOR_IOCTL_CMD_DETACH \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 25, size_t)
+
+#define PTEDITOR_IOCTL_CMD_GET_PAGING_LEVELS \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 26, size_t)
+
+#define PTEDITOR_IOCTL_CMD_VM_BITS \
+  _IOR(PTEDITOR_IOCTL_MAGIC_NUMBER, 27, size_t)
 #else
 #define PTEDITOR_READ_PAGE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x801, METHOD_BUFFERED, FILE_ANY_ACCESS)
 #define PTEDITOR_WRITE_PAGE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x802, METHOD_BUFFERED, FILE_READ_DATA)
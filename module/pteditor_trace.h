@@ -0,0 +1,86 @@
+/* See LICENSE file for license and copyright information */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM pteditor
+
+#if !defined(_PTEDITOR_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _PTEDITOR_TRACE_H
+
+#include <linux/tracepoint.h>
+#include "pteditor.h"
+
+#define show_pteditor_level(level)                  \
+  __print_symbolic(level,                           \
+    { PTEDIT_VALID_MASK_PGD, "PGD" },               \
+    { PTEDIT_VALID_MASK_P4D, "P4D" },               \
+    { PTEDIT_VALID_MASK_PUD, "PUD" },               \
+    { PTEDIT_VALID_MASK_PMD, "PMD" },               \
+    { PTEDIT_VALID_MASK_PTE, "PTE" },               \
+    { 0, "none" })
+
+/* Deepest page-table entry found for an address */
+TRACE_EVENT(pteditor_resolve,
+  TP_PROTO(size_t pid, size_t vaddr, size_t level, size_t entry),
+  TP_ARGS(pid, vaddr, level, entry),
+  TP_STRUCT__entry(
+    __field(size_t, pid)
+    __field(size_t, vaddr)
+    __field(size_t, level)
+    __field(size_t, entry)
+  ),
+  TP_fast_assign(
+    __entry->pid = pid;
+    __entry->vaddr = vaddr;
+    __entry->level = level;
+    __entry->entry = entry;
+  ),
+  TP_printk("pid=%zu vaddr=0x%zx level=%s entry=0x%zx",
+    __entry->pid, __entry->vaddr, show_pteditor_level(__entry->level), __entry->entry)
+);
+
+/* A single page-table entry was replaced */
+TRACE_EVENT(pteditor_update,
+  TP_PROTO(size_t pid, size_t vaddr, size_t level, size_t old_entry, size_t new_entry),
+  TP_ARGS(pid, vaddr, level, old_entry, new_entry),
+  TP_STRUCT__entry(
+    __field(size_t, pid)
+    __field(size_t, vaddr)
+    __field(size_t, level)
+    __field(size_t, old_entry)
+    __field(size_t, new_entry)
+  ),
+  TP_fast_assign(
+    __entry->pid = pid;
+    __entry->vaddr = vaddr;
+    __entry->level = level;
+    __entry->old_entry = old_entry;
+    __entry->new_entry = new_entry;
+  ),
+  TP_printk("pid=%zu vaddr=0x%zx level=%s old=0x%zx new=0x%zx",
+    __entry->pid, __entry->vaddr, show_pteditor_level(__entry->level), __entry->old_entry, __entry->new_entry)
+);
+
+/* TLB invalidation of [start, end), end is TLB_FLUSH_ALL for a full flush */
+TRACE_EVENT(pteditor_invalidate,
+  TP_PROTO(size_t pid, unsigned long start, unsigned long end),
+  TP_ARGS(pid, start, end),
+  TP_STRUCT__entry(
+    __field(size_t, pid)
+    __field(unsigned long, start)
+    __field(unsigned long, end)
+  ),
+  TP_fast_assign(
+    __entry->pid = pid;
+    __entry->start = start;
+    __entry->end = end;
+  ),
+  TP_printk("pid=%zu start=0x%lx end=0x%lx", __entry->pid, __entry->start, __entry->end)
+);
+
+#endif /* _PTEDITOR_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE pteditor_trace
+#include <trace/define_trace.h>
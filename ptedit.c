@@ -8,9 +8,26 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <pthread.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#if defined(IORING_SETUP_SQE128) && defined(__NR_io_uring_setup)
+#define PTEDIT_HAS_IO_URING 1
+#endif
 #else
 #include <Windows.h>
 #endif
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define PTEDIT_HAS_AVX 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #if defined(LINUX)
 #define PTEDIT_COLOR_RED     "\x1b[31m"
@@ -22,6 +39,18 @@
 #define PTEDIT_COLOR_RESET   ""
 #endif
 
+#if defined(_MSC_VER)
+#define PTEDIT_ALWAYS_INLINE __forceinline
+#define PTEDIT_THREAD_LOCAL __declspec(thread)
+#define PTEDIT_ATOMIC_LOAD(x) (*(volatile size_t*)&(x))
+#define PTEDIT_ATOMIC_INC(x) InterlockedIncrement64((volatile LONG64*)&(x))
+#else
+#define PTEDIT_ALWAYS_INLINE inline __attribute__((always_inline))
+#define PTEDIT_THREAD_LOCAL __thread
+#define PTEDIT_ATOMIC_LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define PTEDIT_ATOMIC_INC(x) __atomic_fetch_add(&(x), 1, __ATOMIC_RELEASE)
+#endif
+
 #if defined(WINDOWS)
 #define NO_WINDOWS_SUPPORT fprintf(stderr, PTEDIT_COLOR_RED "[-]" PTEDIT_COLOR_RESET "Error: %s not supported on Windows", __func__);
 #endif
@@ -38,6 +67,38 @@ static size_t ptedit_entry_size = sizeof(size_t);
 static size_t ptedit_paging_root;
 static unsigned char* ptedit_vmem;
 
+#define PTEDIT_PWC_ENTRIES 64
+
+typedef struct {
+    size_t generation;
+    size_t root, prefix;
+    size_t pgd, p4d, pud, pmd;
+    size_t valid;
+    ptedit_location_t location;
+} ptedit_pwc_entry_t;
+
+static int ptedit_pwc_enabled;
+// bumped by any thread to invalidate the caches of all threads
+static size_t ptedit_pwc_gen = 1;
+// one cache per thread, so that concurrent walks never see entries filled halfway by another thread
+static PTEDIT_THREAD_LOCAL ptedit_pwc_entry_t ptedit_pwc[PTEDIT_PWC_ENTRIES];
+
+#if defined(PTEDIT_HAS_IO_URING)
+typedef struct {
+    int initialized;
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+    unsigned queued;
+} ptedit_async_ring_t;
+
+static ptedit_async_ring_t ptedit_ring;
+#endif
+
 typedef struct {
     int has_pgd, has_p4d, has_pud, has_pmd, has_pt;
     int pgd_entries, p4d_entries, pud_entries, pmd_entries, pt_entries;
@@ -62,6 +123,19 @@ ptedit_fnc ptedit_entry_t ptedit_resolve_kernel(void* address, pid_t pid) {
     return vm;
 }
 
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_resolve_batch_kernel(ptedit_entry_t* entries, size_t count, pid_t pid) {
+#if defined(LINUX)
+    ptedit_batch_t batch;
+    batch.pid = (size_t)pid;
+    batch.count = count;
+    batch.data = entries;
+    ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_RESOLVE_BATCH, (size_t)&batch);
+#else
+    NO_WINDOWS_SUPPORT;
+#endif
+}
+
 // ---------------------------------------------------------------------------
 typedef size_t(*ptedit_phys_read_t)(size_t);
 typedef void(*ptedit_phys_write_t)(size_t, size_t);
@@ -106,52 +180,108 @@ static inline void ptedit_phys_write_pwrite(size_t address, size_t value) {
 }
 
 // ---------------------------------------------------------------------------
-static ptedit_entry_t ptedit_resolve_user_ext(void* address, pid_t pid, ptedit_phys_read_t deref) {
+static inline int ptedit_is_leaf(size_t entry) {
+#if defined(__i386__) || defined(__x86_64__) || defined(_WIN64)
+    return ptedit_cast(entry, ptedit_pmd_t).present == PTEDIT_PAGE_PRESENT && ptedit_cast(entry, ptedit_pmd_t).size;
+#elif defined(__aarch64__)
+    // block descriptor
+    return ptedit_cast(entry, ptedit_pmd_t).present == 1;
+#elif defined(__riscv)
+    // directory entries are neither readable nor executable
+    return ptedit_cast(entry, ptedit_pmd_t).present && (ptedit_cast(entry, ptedit_pmd_t).readable || ptedit_cast(entry, ptedit_pmd_t).executable);
+#else
+    return 0;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+static void ptedit_pwc_written(size_t valid) {
+    // only updates of upper levels can make cached walks stale
+    if (valid & (PTEDIT_VALID_MASK_PGD | PTEDIT_VALID_MASK_P4D | PTEDIT_VALID_MASK_PUD | PTEDIT_VALID_MASK_PMD)) {
+        PTEDIT_ATOMIC_INC(ptedit_pwc_gen);
+    }
+}
+
+// ---------------------------------------------------------------------------
+static PTEDIT_ALWAYS_INLINE ptedit_entry_t ptedit_resolve_user_pte(ptedit_entry_t resolved, size_t pmd_entry, size_t pti, ptedit_phys_read_t deref, ptedit_location_t* location, const ptedit_paging_definition_t definition) {
+    // normal 4kb page
+    size_t pfn = (size_t)(ptedit_cast(pmd_entry, ptedit_pmd_t).pfn);
+    location->pte = pfn * ptedit_pfn_multiply + pti * ptedit_entry_size;
+    location->valid |= PTEDIT_VALID_MASK_PTE;
+    resolved.pte = deref(location->pte); //pt[pti];
+    resolved.valid |= PTEDIT_VALID_MASK_PTE;
+    resolved.level = PTEDIT_VALID_MASK_PTE;
+    resolved.page_size = 1ull << definition.page_offset;
+    return resolved;
+}
+
+// ---------------------------------------------------------------------------
+static PTEDIT_ALWAYS_INLINE ptedit_entry_t ptedit_resolve_user_ext(void* address, pid_t pid, ptedit_phys_read_t deref, ptedit_location_t* location, const ptedit_paging_definition_t definition, int cached) {
     size_t root = (pid == 0) ? ptedit_paging_root : ptedit_get_paging_root(pid);
     root = root & ~1;
 
     int pgdi, p4di, pudi, pmdi, pti;
     size_t addr = (size_t)address;
-    pgdi = (addr >> (ptedit_paging_definition.page_offset
-        + ptedit_paging_definition.pt_entries
-        + ptedit_paging_definition.pmd_entries
-        + ptedit_paging_definition.pud_entries
-        + ptedit_paging_definition.p4d_entries)) % (1ull << ptedit_paging_definition.pgd_entries);
-    p4di = (addr >> (ptedit_paging_definition.page_offset
-        + ptedit_paging_definition.pt_entries
-        + ptedit_paging_definition.pmd_entries
-        + ptedit_paging_definition.pud_entries)) % (1ull << ptedit_paging_definition.p4d_entries);
-    pudi = (addr >> (ptedit_paging_definition.page_offset
-        + ptedit_paging_definition.pt_entries
-        + ptedit_paging_definition.pmd_entries)) % (1ull << ptedit_paging_definition.pud_entries);
-    pmdi = (addr >> (ptedit_paging_definition.page_offset
-        + ptedit_paging_definition.pt_entries)) % (1ull << ptedit_paging_definition.pmd_entries);
-    pti = (addr >> ptedit_paging_definition.page_offset) % (1ull << ptedit_paging_definition.pt_entries);
+    pgdi = (addr >> (definition.page_offset
+        + definition.pt_entries
+        + definition.pmd_entries
+        + definition.pud_entries
+        + definition.p4d_entries)) % (1ull << definition.pgd_entries);
+    p4di = (addr >> (definition.page_offset
+        + definition.pt_entries
+        + definition.pmd_entries
+        + definition.pud_entries)) % (1ull << definition.p4d_entries);
+    pudi = (addr >> (definition.page_offset
+        + definition.pt_entries
+        + definition.pmd_entries)) % (1ull << definition.pud_entries);
+    pmdi = (addr >> (definition.page_offset
+        + definition.pt_entries)) % (1ull << definition.pmd_entries);
+    pti = (addr >> definition.page_offset) % (1ull << definition.pt_entries);
 
     ptedit_entry_t resolved;
     memset(&resolved, 0, sizeof(resolved));
     resolved.vaddr = (size_t)address;
     resolved.pid = (size_t)pid;
     resolved.valid = 0;
+    memset(location, 0, sizeof(*location));
     
     if(!root) return resolved;
 
-    size_t pgd_entry, p4d_entry, pud_entry, pmd_entry, pt_entry;
+    // upper levels are shared by all addresses with the same PMD index
+    size_t prefix = addr >> (definition.page_offset + definition.pt_entries);
+    ptedit_pwc_entry_t* pwc = &ptedit_pwc[prefix % PTEDIT_PWC_ENTRIES];
+    size_t generation = PTEDIT_ATOMIC_LOAD(ptedit_pwc_gen);
+    if (cached && pwc->generation == generation && pwc->root == root && pwc->prefix == prefix) {
+        resolved.pgd = pwc->pgd;
+        resolved.p4d = pwc->p4d;
+        resolved.pud = pwc->pud;
+        resolved.pmd = pwc->pmd;
+        resolved.valid = pwc->valid;
+        *location = pwc->location;
+        return ptedit_resolve_user_pte(resolved, pwc->pmd, pti, deref, location, definition);
+    }
+
+    size_t pgd_entry, p4d_entry, pud_entry, pmd_entry;
 
     //     printf("%zx + CR3(%zx) + PGDI(%zx) * 8 = %zx\n", ptedit_vmem, root, pgdi, ptedit_vmem + root + pgdi * ptedit_entry_size);
-    pgd_entry = deref(root + pgdi * ptedit_entry_size);
+    location->pgd = root + pgdi * ptedit_entry_size;
+    pgd_entry = deref(location->pgd);
     if (ptedit_cast(pgd_entry, ptedit_pgd_t).present != PTEDIT_PAGE_PRESENT) {
         return resolved;
     }
     resolved.pgd = pgd_entry;
     resolved.valid |= PTEDIT_VALID_MASK_PGD;
-    if (ptedit_paging_definition.has_p4d) {
+    location->valid |= PTEDIT_VALID_MASK_PGD;
+    if (definition.has_p4d) {
         size_t pfn = (size_t)(ptedit_cast(pgd_entry, ptedit_pgd_t).pfn);
-        p4d_entry = deref(pfn * ptedit_pfn_multiply + p4di * ptedit_entry_size);
+        location->p4d = pfn * ptedit_pfn_multiply + p4di * ptedit_entry_size;
+        p4d_entry = deref(location->p4d);
         resolved.valid |= PTEDIT_VALID_MASK_P4D;
+        location->valid |= PTEDIT_VALID_MASK_P4D;
     }
     else {
         p4d_entry = pgd_entry;
+        location->p4d = location->pgd;
     }
     resolved.p4d = p4d_entry;
 
@@ -160,131 +290,889 @@ static ptedit_entry_t ptedit_resolve_user_ext(void* address, pid_t pid, ptedit_p
     }
 
 
-    if (ptedit_paging_definition.has_pud) {
+    if (definition.has_pud) {
         size_t pfn = (size_t)(ptedit_cast(p4d_entry, ptedit_p4d_t).pfn);
-        pud_entry = deref(pfn * ptedit_pfn_multiply + pudi * ptedit_entry_size);
+        location->pud = pfn * ptedit_pfn_multiply + pudi * ptedit_entry_size;
+        pud_entry = deref(location->pud);
         resolved.valid |= PTEDIT_VALID_MASK_PUD;
+        location->valid |= PTEDIT_VALID_MASK_PUD;
     }
     else {
         pud_entry = p4d_entry;
+        location->pud = location->p4d;
     }
     resolved.pud = pud_entry;
 
+    if (definition.has_pud && ptedit_is_leaf(pud_entry)) {
+        // 1 GB page
+        resolved.level = PTEDIT_VALID_MASK_PUD;
+        resolved.page_size = 1ull << (definition.page_offset + definition.pt_entries + definition.pmd_entries);
+        return resolved;
+    }
     if (ptedit_cast(pud_entry, ptedit_pud_t).present != PTEDIT_PAGE_PRESENT) {
         return resolved;
     }
 
-    if (ptedit_paging_definition.has_pmd) {
+    if (definition.has_pmd) {
         size_t pfn = (size_t)(ptedit_cast(pud_entry, ptedit_pud_t).pfn);
-        pmd_entry = deref(pfn * ptedit_pfn_multiply + pmdi * ptedit_entry_size);
+        location->pmd = pfn * ptedit_pfn_multiply + pmdi * ptedit_entry_size;
+        pmd_entry = deref(location->pmd);
         resolved.valid |= PTEDIT_VALID_MASK_PMD;
+        location->valid |= PTEDIT_VALID_MASK_PMD;
     }
     else {
         pmd_entry = pud_entry;
+        location->pmd = location->pud;
     }
     resolved.pmd = pmd_entry;
 
+    if (definition.has_pmd && ptedit_is_leaf(pmd_entry)) {
+        // 2 MB page
+        resolved.level = PTEDIT_VALID_MASK_PMD;
+        resolved.page_size = 1ull << (definition.page_offset + definition.pt_entries);
+        return resolved;
+    }
     if (ptedit_cast(pmd_entry, ptedit_pmd_t).present != PTEDIT_PAGE_PRESENT) {
         return resolved;
     }
 
+    if (ptedit_pwc_enabled) {
+        pwc->generation = generation;
+        pwc->root = root;
+        pwc->prefix = prefix;
+        pwc->pgd = resolved.pgd;
+        pwc->p4d = resolved.p4d;
+        pwc->pud = resolved.pud;
+        pwc->pmd = resolved.pmd;
+        pwc->valid = resolved.valid;
+        pwc->location = *location;
+    }
+
+    return ptedit_resolve_user_pte(resolved, pmd_entry, pti, deref, location, definition);
+}
+
+
+// ---------------------------------------------------------------------------
+static ptedit_entry_t ptedit_resolve_user(void* address, pid_t pid) {
+    ptedit_location_t location;
+    return ptedit_resolve_user_ext(address, pid, ptedit_phys_read_pread, &location, ptedit_paging_definition, ptedit_pwc_enabled);
+}
+
+
+// ---------------------------------------------------------------------------
+static ptedit_entry_t ptedit_resolve_user_map(void* address, pid_t pid) {
+    ptedit_location_t location;
+    return ptedit_resolve_user_ext(address, pid, ptedit_phys_read_map, &location, ptedit_paging_definition, ptedit_pwc_enabled);
+}
+
+
+// ---------------------------------------------------------------------------
+// Page walks specialized for the paging layouts of the supported architectures.
+// Shifts and masks are constants and the physical reads are inlined.
+#define PTEDIT_LAYOUT(pgd, p4d, pud, pmd, pt, offset) { 1, (p4d) != 0, (pud) != 0, (pmd) != 0, 1, pgd, p4d, pud, pmd, pt, offset }
+
+#define PTEDIT_WALKER(name, pgd, p4d, pud, pmd, pt, offset) \
+static const ptedit_paging_definition_t ptedit_layout_##name = PTEDIT_LAYOUT(pgd, p4d, pud, pmd, pt, offset); \
+static ptedit_entry_t ptedit_resolve_user_##name(void* address, pid_t pid) { \
+    ptedit_location_t location; \
+    return ptedit_resolve_user_ext(address, pid, ptedit_phys_read_pread, &location, ptedit_layout_##name, ptedit_pwc_enabled); \
+} \
+static ptedit_entry_t ptedit_resolve_user_map_##name(void* address, pid_t pid) { \
+    ptedit_location_t location; \
+    return ptedit_resolve_user_ext(address, pid, ptedit_phys_read_map, &location, ptedit_layout_##name, ptedit_pwc_enabled); \
+}
+
+#define PTEDIT_WALKER_ENTRY(name) { &ptedit_layout_##name, ptedit_resolve_user_##name, ptedit_resolve_user_map_##name }
+
 #if defined(__i386__) || defined(__x86_64__) || defined(_WIN64)
-    if (!ptedit_cast(pmd_entry, ptedit_pmd_t).size) {
-#endif
-        // normal 4kb page
-        size_t pfn = (size_t)(ptedit_cast(pmd_entry, ptedit_pmd_t).pfn);
-        pt_entry = deref(pfn * ptedit_pfn_multiply + pti * ptedit_entry_size); //pt[pti];
-        resolved.pte = pt_entry;
-        resolved.valid |= PTEDIT_VALID_MASK_PTE;
-        if (ptedit_cast(pt_entry, ptedit_pte_t).present != PTEDIT_PAGE_PRESENT) {
-            return resolved;
-        }
+PTEDIT_WALKER(x86_4level, 9, 0, 9, 9, 9, 12)
+PTEDIT_WALKER(x86_5level, 9, 9, 9, 9, 9, 12)
+#elif defined(__aarch64__)
+PTEDIT_WALKER(arm64_4k_3level, 9, 0, 0, 9, 9, 12)
+PTEDIT_WALKER(arm64_4k_4level, 9, 0, 9, 9, 9, 12)
+PTEDIT_WALKER(arm64_16k, 11, 0, 11, 11, 11, 14)
+#elif defined(__riscv)
+PTEDIT_WALKER(sv39, 9, 0, 0, 9, 9, 12)
+PTEDIT_WALKER(sv48, 9, 0, 9, 9, 9, 12)
+PTEDIT_WALKER(sv57, 9, 9, 9, 9, 9, 12)
+#endif
+
+typedef struct {
+    const ptedit_paging_definition_t* definition;
+    ptedit_resolve_t resolve, resolve_map;
+} ptedit_walker_t;
+
+static const ptedit_walker_t ptedit_walkers[] = {
 #if defined(__i386__) || defined(__x86_64__) || defined(_WIN64)
+    PTEDIT_WALKER_ENTRY(x86_4level),
+    PTEDIT_WALKER_ENTRY(x86_5level),
+#elif defined(__aarch64__)
+    PTEDIT_WALKER_ENTRY(arm64_4k_3level),
+    PTEDIT_WALKER_ENTRY(arm64_4k_4level),
+    PTEDIT_WALKER_ENTRY(arm64_16k),
+#elif defined(__riscv)
+    PTEDIT_WALKER_ENTRY(sv39),
+    PTEDIT_WALKER_ENTRY(sv48),
+    PTEDIT_WALKER_ENTRY(sv57),
+#endif
+    // generic page walk for any other layout
+    { NULL, ptedit_resolve_user, ptedit_resolve_user_map }
+};
+
+static ptedit_resolve_t ptedit_resolve_user_walk = ptedit_resolve_user;
+static ptedit_resolve_t ptedit_resolve_user_map_walk = ptedit_resolve_user_map;
+
+// ---------------------------------------------------------------------------
+static void ptedit_select_walker() {
+    size_t i;
+    for (i = 0; i < sizeof(ptedit_walkers) / sizeof(ptedit_walkers[0]); i++) {
+        if (!ptedit_walkers[i].definition || !memcmp(ptedit_walkers[i].definition, &ptedit_paging_definition, sizeof(ptedit_paging_definition))) {
+            ptedit_resolve_user_walk = ptedit_walkers[i].resolve;
+            ptedit_resolve_user_map_walk = ptedit_walkers[i].resolve_map;
+            return;
+        }
     }
+}
+
+
+// ---------------------------------------------------------------------------
+static void ptedit_resolve_batch_user(ptedit_entry_t* entries, size_t count, pid_t pid) {
+    size_t i;
+    for (i = 0; i < count; i++) {
+        entries[i] = ptedit_resolve((void*)entries[i].vaddr, pid);
+    }
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_update_kernel(void* address, pid_t pid, ptedit_entry_t* vm) {
+    vm->vaddr = (size_t)address;
+    vm->pid = (size_t)pid;
+    ptedit_pwc_written(vm->valid);
+#if defined(LINUX)
+    ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_UPDATE, (size_t)vm);
+#else 
+    NO_WINDOWS_SUPPORT
 #endif
-    return resolved;
 }
 
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_update_batch_kernel(ptedit_entry_t* entries, size_t count, pid_t pid) {
+    size_t i;
+    for (i = 0; i < count; i++) {
+        ptedit_pwc_written(entries[i].valid);
+    }
+#if defined(LINUX)
+    ptedit_batch_t batch;
+    batch.pid = (size_t)pid;
+    batch.count = count;
+    batch.data = entries;
+    ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_UPDATE_BATCH, (size_t)&batch);
+#else
+    NO_WINDOWS_SUPPORT
+#endif
+}
+
+// ---------------------------------------------------------------------------
+static void ptedit_update_batch_user(ptedit_entry_t* entries, size_t count, pid_t pid) {
+    size_t i;
+    for (i = 0; i < count; i++) {
+        ptedit_update((void*)entries[i].vaddr, pid, &entries[i]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+static void ptedit_locate_kernel(void* address, pid_t pid, ptedit_entry_t* entry, ptedit_location_t* location) {
+    size_t root = ptedit_get_paging_root(pid) & ~1;
+    memset(location, 0, sizeof(*location));
+    if(!root) return;
+
+    size_t pgdi, p4di, pudi, pmdi, pti;
+    size_t addr = (size_t)address;
+    pgdi = (addr >> (ptedit_paging_definition.page_offset
+        + ptedit_paging_definition.pt_entries
+        + ptedit_paging_definition.pmd_entries
+        + ptedit_paging_definition.pud_entries
+        + ptedit_paging_definition.p4d_entries)) % (1ull << ptedit_paging_definition.pgd_entries);
+    p4di = (addr >> (ptedit_paging_definition.page_offset
+        + ptedit_paging_definition.pt_entries
+        + ptedit_paging_definition.pmd_entries
+        + ptedit_paging_definition.pud_entries)) % (1ull << ptedit_paging_definition.p4d_entries);
+    pudi = (addr >> (ptedit_paging_definition.page_offset
+        + ptedit_paging_definition.pt_entries
+        + ptedit_paging_definition.pmd_entries)) % (1ull << ptedit_paging_definition.pud_entries);
+    pmdi = (addr >> (ptedit_paging_definition.page_offset
+        + ptedit_paging_definition.pt_entries)) % (1ull << ptedit_paging_definition.pmd_entries);
+    pti = (addr >> ptedit_paging_definition.page_offset) % (1ull << ptedit_paging_definition.pt_entries);
+
+    location->valid = entry->valid;
+    location->pgd = root + pgdi * ptedit_entry_size;
+    location->p4d = ptedit_paging_definition.has_p4d ? (size_t)ptedit_cast(entry->pgd, ptedit_pgd_t).pfn * ptedit_pfn_multiply + p4di * ptedit_entry_size : location->pgd;
+    location->pud = ptedit_paging_definition.has_pud ? (size_t)ptedit_cast(entry->p4d, ptedit_p4d_t).pfn * ptedit_pfn_multiply + pudi * ptedit_entry_size : location->p4d;
+    location->pmd = ptedit_paging_definition.has_pmd ? (size_t)ptedit_cast(entry->pud, ptedit_pud_t).pfn * ptedit_pfn_multiply + pmdi * ptedit_entry_size : location->pud;
+    if (entry->valid & PTEDIT_VALID_MASK_PTE) {
+        location->pte = (size_t)ptedit_cast(entry->pmd, ptedit_pmd_t).pfn * ptedit_pfn_multiply + pti * ptedit_entry_size;
+    }
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc ptedit_entry_t ptedit_resolve_locations(void* address, pid_t pid, ptedit_location_t* location) {
+    // the locations are written to, a stale cached walk would point to a freed page table
+    if (ptedit_resolve == ptedit_resolve_user_walk) {
+        return ptedit_resolve_user_ext(address, pid, ptedit_phys_read_pread, location, ptedit_paging_definition, 0);
+    }
+    if (ptedit_resolve == ptedit_resolve_user_map_walk) {
+        return ptedit_resolve_user_ext(address, pid, ptedit_phys_read_map, location, ptedit_paging_definition, 0);
+    }
+    ptedit_entry_t entry = ptedit_resolve(address, pid);
+    ptedit_locate_kernel(address, pid, &entry, location);
+    return entry;
+}
+
+// ---------------------------------------------------------------------------
+static void ptedit_write_locations(ptedit_entry_t* vm, ptedit_location_t* location, ptedit_phys_write_t pset) {
+    ptedit_pwc_written(vm->valid);
+
+    if ((vm->valid & PTEDIT_VALID_MASK_PTE) && (location->valid & PTEDIT_VALID_MASK_PTE)) {
+        pset(location->pte, vm->pte);
+    }
+    if ((vm->valid & PTEDIT_VALID_MASK_PMD) && (location->valid & PTEDIT_VALID_MASK_PMD) && ptedit_paging_definition.has_pmd) {
+        pset(location->pmd, vm->pmd);
+    }
+    if ((vm->valid & PTEDIT_VALID_MASK_PUD) && (location->valid & PTEDIT_VALID_MASK_PUD) && ptedit_paging_definition.has_pud) {
+        pset(location->pud, vm->pud);
+    }
+    if ((vm->valid & PTEDIT_VALID_MASK_P4D) && (location->valid & PTEDIT_VALID_MASK_P4D) && ptedit_paging_definition.has_p4d) {
+        pset(location->p4d, vm->p4d);
+    }
+    if ((vm->valid & PTEDIT_VALID_MASK_PGD) && (location->valid & PTEDIT_VALID_MASK_PGD) && ptedit_paging_definition.has_pgd) {
+        pset(location->pgd, vm->pgd);
+    }
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_update_user_ext(void* address, pid_t pid, ptedit_entry_t* vm, ptedit_phys_write_t pset) {
+    ptedit_location_t location;
+    ptedit_resolve_locations(address, pid, &location);
+    if (!location.valid) return;
+
+    ptedit_write_locations(vm, &location, pset);
+    ptedit_invalidate_tlb(address);
+}
+
+// ---------------------------------------------------------------------------
+static void ptedit_update_user(void* address, pid_t pid, ptedit_entry_t* vm) {
+    ptedit_update_user_ext(address, pid, vm, ptedit_phys_write_pwrite);
+}
+
+
+// ---------------------------------------------------------------------------
+static void ptedit_update_user_map(void* address, pid_t pid, ptedit_entry_t* vm) {
+    ptedit_update_user_ext(address, pid, vm, ptedit_phys_write_map);
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_update_locations(void* address, pid_t pid, ptedit_entry_t* vm, ptedit_location_t* location) {
+    if (ptedit_update == ptedit_update_user) {
+        ptedit_write_locations(vm, location, ptedit_phys_write_pwrite);
+    }
+    else if (ptedit_update == ptedit_update_user_map) {
+        ptedit_write_locations(vm, location, ptedit_phys_write_map);
+    }
+    else {
+        // the kernel implementation walks the page tables itself and flushes the TLB
+        ptedit_update(address, pid, vm);
+        return;
+    }
+    ptedit_invalidate_tlb(address);
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_dump_range(pid_t pid, size_t* start, size_t end, ptedit_leaf_t* leaves, size_t count) {
+#if defined(LINUX)
+    ptedit_range_t range;
+    range.pid = (size_t)pid;
+    range.start = *start;
+    range.end = end;
+    range.count = count;
+    range.leaves = leaves;
+    if (ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_DUMP, (size_t)&range)) {
+        return 0;
+    }
+    *start = range.start;
+    return range.count;
+#else
+    NO_WINDOWS_SUPPORT
+    return 0;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+typedef struct {
+    int depth;
+    size_t entry, vaddr;
+} ptedit_walk_task_t;
+
+typedef struct {
+    size_t start, end;
+    int flags;
+    ptedit_walk_callback_t callback;
+    void* ctx;
+    int levels;
+    int bits[5], shift[5];
+    size_t mask[5];
+    size_t va_bits;
+    unsigned char* buffer;
+    int stop;
+    // entries of this depth are collected as tasks instead of being walked
+    int split;
+    ptedit_walk_task_t* tasks;
+    size_t task_count, task_capacity;
+} ptedit_walk_t;
+
+// ---------------------------------------------------------------------------
+static size_t* ptedit_walk_table(ptedit_walk_t* walk, int depth, size_t table) {
+    if (ptedit_vmem) {
+        // the table is already mapped, no copy required
+        return (size_t*)(ptedit_vmem + table);
+    }
+    size_t* buffer = (size_t*)(walk->buffer + depth * ptedit_pagesize);
+    ptedit_read_physical_page(table / ptedit_pagesize, (char*)buffer);
+    return buffer;
+}
+
+static void ptedit_walk_level(ptedit_walk_t* walk, int depth, size_t table, size_t base);
+
+// ---------------------------------------------------------------------------
+static void ptedit_walk_entry(ptedit_walk_t* walk, int depth, size_t entry, size_t vaddr) {
+    ptedit_leaf_t leaf;
+    int last = (depth == walk->levels - 1);
+    int is_leaf = last || ptedit_is_leaf(entry);
+
+    if (!is_leaf && ptedit_cast(entry, ptedit_pgd_t).present != PTEDIT_PAGE_PRESENT) {
+        return;
+    }
+    if (last && ptedit_cast(entry, ptedit_pte_t).present != PTEDIT_PAGE_PRESENT && (!(walk->flags & PTEDIT_WALK_NONPRESENT) || !entry)) {
+        return;
+    }
+    if (walk->tasks && (is_leaf || depth == walk->split)) {
+        if (walk->task_count == walk->task_capacity) {
+            size_t capacity = walk->task_capacity ? walk->task_capacity * 2 : 256;
+            ptedit_walk_task_t* tasks = (ptedit_walk_task_t*)realloc(walk->tasks, capacity * sizeof(ptedit_walk_task_t));
+            if (!tasks) {
+                walk->stop = 1;
+                return;
+            }
+            walk->tasks = tasks;
+            walk->task_capacity = capacity;
+        }
+        walk->tasks[walk->task_count].depth = depth;
+        walk->tasks[walk->task_count].entry = entry;
+        walk->tasks[walk->task_count].vaddr = vaddr;
+        walk->task_count++;
+        return;
+    }
+    if (is_leaf) {
+        leaf.vaddr = vaddr;
+        leaf.entry = entry;
+        leaf.level = walk->mask[depth];
+        leaf.size = 1ull << walk->shift[depth];
+        walk->stop = walk->callback(&leaf, walk->ctx);
+        return;
+    }
+    ptedit_walk_level(walk, depth + 1, (size_t)ptedit_cast(entry, ptedit_pgd_t).pfn * ptedit_pfn_multiply, vaddr);
+}
+
+// ---------------------------------------------------------------------------
+static void ptedit_walk_level(ptedit_walk_t* walk, int depth, size_t table, size_t base) {
+    size_t* entries = ptedit_walk_table(walk, depth, table);
+    size_t size = 1ull << walk->shift[depth];
+    size_t count = 1ull << walk->bits[depth];
+    size_t first = 0, last = count - 1, i;
+
+    if (depth) {
+        // lower levels only cover the range of the parent entry
+        if (walk->start > base) first = (walk->start - base) >> walk->shift[depth];
+        if (walk->end - 1 < base + (count * size - 1)) last = (walk->end - 1 - base) >> walk->shift[depth];
+    }
+
+    for (i = first; i <= last && !walk->stop; i++) {
+        size_t vaddr = base + i * size;
+#if defined(__i386__) || defined(__x86_64__) || defined(_WIN64) || defined(__riscv)
+        if (!depth && (vaddr >> (walk->va_bits - 1)) & 1) {
+            // canonical upper half
+            vaddr |= ~((1ull << walk->va_bits) - 1);
+        }
+#endif
+        if (!depth && (vaddr >= walk->end || vaddr + (size - 1) < walk->start)) {
+            continue;
+        }
+        ptedit_walk_entry(walk, depth, entries[i], vaddr);
+    }
+}
+
+// ---------------------------------------------------------------------------
+static size_t ptedit_walk_init(ptedit_walk_t* walk, pid_t pid, void* start, void* end, int flags, ptedit_walk_callback_t callback) {
+    int has[5] = { ptedit_paging_definition.has_pgd, ptedit_paging_definition.has_p4d, ptedit_paging_definition.has_pud, ptedit_paging_definition.has_pmd, ptedit_paging_definition.has_pt };
+    int bits[5] = { ptedit_paging_definition.pgd_entries, ptedit_paging_definition.p4d_entries, ptedit_paging_definition.pud_entries, ptedit_paging_definition.pmd_entries, ptedit_paging_definition.pt_entries };
+    size_t mask[5] = { PTEDIT_VALID_MASK_PGD, PTEDIT_VALID_MASK_P4D, PTEDIT_VALID_MASK_PUD, PTEDIT_VALID_MASK_PMD, PTEDIT_VALID_MASK_PTE };
+    int level, shift;
+
+    size_t root = ptedit_get_paging_root(pid) & ~1;
+    if (!root || !callback || (size_t)start >= (size_t)end) {
+        return 0;
+    }
+
+    memset(walk, 0, sizeof(*walk));
+    walk->start = (size_t)start;
+    walk->end = (size_t)end;
+    walk->flags = flags;
+    walk->callback = callback;
+    walk->split = -1;
+    // skip folded levels
+    for (level = 0; level < 5; level++) {
+        if (!has[level] || !bits[level]) continue;
+        walk->bits[walk->levels] = bits[level];
+        walk->mask[walk->levels] = mask[level];
+        walk->levels++;
+    }
+    shift = ptedit_paging_definition.page_offset;
+    for (level = walk->levels - 1; level >= 0; level--) {
+        walk->shift[level] = shift;
+        shift += walk->bits[level];
+    }
+    walk->va_bits = (size_t)shift;
+    return root;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_walk_range(pid_t pid, void* start, void* end, int flags, ptedit_walk_callback_t callback, void* ctx) {
+    ptedit_walk_t walk;
+    size_t root = ptedit_walk_init(&walk, pid, start, end, flags, callback);
+    if (!root) {
+        return -1;
+    }
+    walk.ctx = ctx;
+    if (!ptedit_vmem) {
+        walk.buffer = (unsigned char*)malloc(walk.levels * ptedit_pagesize);
+        if (!walk.buffer) {
+            return -1;
+        }
+    }
+    ptedit_walk_level(&walk, 0, root, 0);
+    free(walk.buffer);
+    return 0;
+}
+
+#if defined(LINUX)
+typedef struct {
+    // claimed with an atomic increment, both by the owner and by stealing workers
+    size_t next;
+    size_t end;
+} ptedit_walk_queue_t;
+
+typedef struct {
+    ptedit_walk_t walk;
+    ptedit_walk_task_t* tasks;
+    ptedit_walk_queue_t* queues;
+    int id, threads;
+    int* stop;
+    pthread_t thread;
+} ptedit_walk_worker_t;
+
+// ---------------------------------------------------------------------------
+static void* ptedit_walk_worker(void* arg) {
+    ptedit_walk_worker_t* worker = (ptedit_walk_worker_t*)arg;
+    int victim;
+    // drain the own queue first, then steal from the others
+    for (victim = 0; victim < worker->threads; victim++) {
+        ptedit_walk_queue_t* queue = &worker->queues[(worker->id + victim) % worker->threads];
+        while (!__atomic_load_n(worker->stop, __ATOMIC_RELAXED)) {
+            size_t i = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED);
+            if (i >= queue->end) break;
+            ptedit_walk_entry(&worker->walk, worker->tasks[i].depth, worker->tasks[i].entry, worker->tasks[i].vaddr);
+            if (worker->walk.stop) {
+                __atomic_store_n(worker->stop, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    return NULL;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_walk_range_parallel(pid_t pid, void* start, void* end, int flags, ptedit_walk_callback_t callback, void** ctx, int threads) {
+#if defined(LINUX)
+    ptedit_walk_t walk;
+    ptedit_walk_worker_t* workers;
+    ptedit_walk_queue_t* queues;
+    int t, started, stop = 0, result = 0;
+
+    size_t root = ptedit_walk_init(&walk, pid, start, end, flags, callback);
+    if (!root || threads < 1) {
+        return -1;
+    }
+    // split the range into tasks of PUD granularity (e.g., 1 GB with 4 KB pages)
+    walk.split = walk.levels > 3 ? walk.levels - 3 : 0;
+    walk.tasks = (ptedit_walk_task_t*)malloc(256 * sizeof(ptedit_walk_task_t));
+    walk.task_capacity = 256;
+    walk.buffer = (unsigned char*)malloc(walk.levels * ptedit_pagesize);
+    workers = (ptedit_walk_worker_t*)calloc(threads, sizeof(ptedit_walk_worker_t));
+    queues = (ptedit_walk_queue_t*)calloc(threads, sizeof(ptedit_walk_queue_t));
+    if (!walk.tasks || !walk.buffer || !workers || !queues) {
+        result = -1;
+        goto cleanup;
+    }
+    ptedit_walk_level(&walk, 0, root, 0);
+    if (walk.stop) {
+        result = -1;
+        goto cleanup;
+    }
+
+    for (t = 0; t < threads; t++) {
+        queues[t].next = walk.task_count * t / threads;
+        queues[t].end = walk.task_count * (t + 1) / threads;
+        workers[t].walk = walk;
+        workers[t].walk.tasks = NULL;
+        workers[t].walk.split = -1;
+        workers[t].walk.ctx = ctx ? ctx[t] : NULL;
+        workers[t].walk.buffer = ptedit_vmem ? NULL : (unsigned char*)malloc(walk.levels * ptedit_pagesize);
+        workers[t].tasks = walk.tasks;
+        workers[t].queues = queues;
+        workers[t].id = t;
+        workers[t].threads = threads;
+        workers[t].stop = &stop;
+        if (!ptedit_vmem && !workers[t].walk.buffer) {
+            result = -1;
+            goto cleanup;
+        }
+    }
+
+    // the calling thread is the first worker
+    for (started = 1; started < threads; started++) {
+        if (pthread_create(&workers[started].thread, NULL, ptedit_walk_worker, &workers[started])) {
+            break;
+        }
+    }
+    ptedit_walk_worker(&workers[0]);
+    for (t = 1; t < started; t++) {
+        pthread_join(workers[t].thread, NULL);
+    }
+
+cleanup:
+    if (workers) {
+        for (t = 0; t < threads; t++) {
+            free(workers[t].walk.buffer);
+        }
+    }
+    free(workers);
+    free(queues);
+    free(walk.tasks);
+    free(walk.buffer);
+    return result;
+#else
+    NO_WINDOWS_SUPPORT
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+typedef struct {
+    size_t mask, value;
+    size_t pfn_mask, pfn_low, pfn_high;
+} ptedit_filter_prepared_t;
+
+typedef unsigned long long (*ptedit_filter64_t)(const size_t*, const ptedit_filter_prepared_t*);
+
+// ---------------------------------------------------------------------------
+static unsigned long long ptedit_filter_scalar(const size_t* entries, size_t count, const ptedit_filter_prepared_t* filter) {
+    unsigned long long result = 0;
+    size_t i;
+    for (i = 0; i < count; i++) {
+        size_t pfn = entries[i] & filter->pfn_mask;
+        if ((entries[i] & filter->mask) == filter->value && pfn >= filter->pfn_low && pfn <= filter->pfn_high) {
+            result |= 1ull << i;
+        }
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+static unsigned long long ptedit_filter64_scalar(const size_t* entries, const ptedit_filter_prepared_t* filter) {
+    return ptedit_filter_scalar(entries, 64, filter);
+}
+
+#if defined(PTEDIT_HAS_AVX) && defined(__x86_64__)
+// ---------------------------------------------------------------------------
+__attribute__((target("avx2"))) static unsigned long long ptedit_filter64_avx2(const size_t* entries, const ptedit_filter_prepared_t* filter) {
+    // masked PFNs are below 2^63, thus the signed comparison is sufficient
+    __m256i mask = _mm256_set1_epi64x((long long)filter->mask), value = _mm256_set1_epi64x((long long)filter->value);
+    __m256i pfn_mask = _mm256_set1_epi64x((long long)filter->pfn_mask);
+    __m256i low = _mm256_set1_epi64x((long long)filter->pfn_low), high = _mm256_set1_epi64x((long long)filter->pfn_high);
+    unsigned long long result = 0;
+    size_t i;
+    for (i = 0; i < 64; i += 4) {
+        __m256i entry = _mm256_loadu_si256((const __m256i*)(entries + i));
+        __m256i match = _mm256_cmpeq_epi64(_mm256_and_si256(entry, mask), value);
+        __m256i pfn = _mm256_and_si256(entry, pfn_mask);
+        __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi64(low, pfn), _mm256_cmpgt_epi64(pfn, high));
+        match = _mm256_andnot_si256(outside, match);
+        result |= (unsigned long long)_mm256_movemask_pd(_mm256_castsi256_pd(match)) << i;
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+__attribute__((target("avx512f"))) static unsigned long long ptedit_filter64_avx512(const size_t* entries, const ptedit_filter_prepared_t* filter) {
+    __m512i mask = _mm512_set1_epi64((long long)filter->mask), value = _mm512_set1_epi64((long long)filter->value);
+    __m512i pfn_mask = _mm512_set1_epi64((long long)filter->pfn_mask);
+    __m512i low = _mm512_set1_epi64((long long)filter->pfn_low), high = _mm512_set1_epi64((long long)filter->pfn_high);
+    unsigned long long result = 0;
+    size_t i;
+    for (i = 0; i < 64; i += 8) {
+        __m512i entry = _mm512_loadu_si512((const void*)(entries + i));
+        __mmask8 match = _mm512_cmpeq_epu64_mask(_mm512_and_si512(entry, mask), value);
+        __m512i pfn = _mm512_and_si512(entry, pfn_mask);
+        match = _mm512_mask_cmpge_epu64_mask(match, pfn, low);
+        match = _mm512_mask_cmple_epu64_mask(match, pfn, high);
+        result |= (unsigned long long)match << i;
+    }
+    return result;
+}
+#elif defined(__aarch64__)
+// ---------------------------------------------------------------------------
+static unsigned long long ptedit_filter64_neon(const size_t* entries, const ptedit_filter_prepared_t* filter) {
+    uint64x2_t mask = vdupq_n_u64(filter->mask), value = vdupq_n_u64(filter->value);
+    uint64x2_t pfn_mask = vdupq_n_u64(filter->pfn_mask);
+    uint64x2_t low = vdupq_n_u64(filter->pfn_low), high = vdupq_n_u64(filter->pfn_high);
+    unsigned long long result = 0;
+    size_t i;
+    for (i = 0; i < 64; i += 2) {
+        uint64x2_t entry = vld1q_u64((const uint64_t*)(entries + i));
+        uint64x2_t match = vceqq_u64(vandq_u64(entry, mask), value);
+        uint64x2_t pfn = vandq_u64(entry, pfn_mask);
+        match = vandq_u64(match, vandq_u64(vcgeq_u64(pfn, low), vcleq_u64(pfn, high)));
+        result |= ((vgetq_lane_u64(match, 0) & 1) | ((vgetq_lane_u64(match, 1) & 1) << 1)) << i;
+    }
+    return result;
+}
+#endif
+
+static ptedit_filter64_t ptedit_filter64 = ptedit_filter64_scalar;
+
+// ---------------------------------------------------------------------------
+static void ptedit_select_filter() {
+#if defined(PTEDIT_HAS_AVX) && defined(__x86_64__)
+    if (__builtin_cpu_supports("avx512f")) {
+        ptedit_filter64 = ptedit_filter64_avx512;
+    }
+    else if (__builtin_cpu_supports("avx2")) {
+        ptedit_filter64 = ptedit_filter64_avx2;
+    }
+#elif defined(__aarch64__)
+    ptedit_filter64 = ptedit_filter64_neon;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+static inline int ptedit_lowest_bit(unsigned long long bits) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int i = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_filter_table(size_t* entries, size_t count, ptedit_filter_t* filter, unsigned char* bitmap, size_t* indices) {
+    ptedit_filter_prepared_t prepared;
+    size_t matches = 0, i, b;
+    int shift;
+
+    // all bits cleared by setting the PFN to 0
+    prepared.pfn_mask = ~ptedit_set_pfn((size_t)-1, 0);
+    shift = ptedit_lowest_bit(prepared.pfn_mask);
+    prepared.mask = filter->mask;
+    prepared.value = filter->value & filter->mask;
+    prepared.pfn_low = (filter->pfn_min > (prepared.pfn_mask >> shift) ? (prepared.pfn_mask >> shift) + 1 : filter->pfn_min) << shift;
+    prepared.pfn_high = (filter->pfn_max > (prepared.pfn_mask >> shift) ? (prepared.pfn_mask >> shift) : filter->pfn_max) << shift;
+
+    for (i = 0; i < count; i += 64) {
+        size_t n = (count - i < 64) ? count - i : 64;
+        unsigned long long bits = (n == 64) ? ptedit_filter64(entries + i, &prepared) : ptedit_filter_scalar(entries + i, n, &prepared);
+        if (bitmap) {
+            for (b = 0; b < (n + 7) / 8; b++) {
+                bitmap[i / 8 + b] = (unsigned char)(bits >> (b * 8));
+            }
+        }
+        while (bits) {
+            if (indices) {
+                indices[matches] = i + ptedit_lowest_bit(bits);
+            }
+            matches++;
+            bits &= bits - 1;
+        }
+    }
+    return matches;
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_harvest_accessed_dirty(pid_t pid, void* start, void* end, size_t* accessed, size_t* dirty, int flags) {
+#if defined(LINUX)
+    ptedit_harvest_t harvest;
+    harvest.pid = (size_t)pid;
+    harvest.start = (size_t)start;
+    harvest.end = (size_t)end;
+    harvest.flags = (size_t)flags;
+    harvest.accessed = accessed;
+    harvest.dirty = dirty;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_HARVEST, (size_t)&harvest) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_watch(pid_t pid, void* start, void* end) {
+#if defined(LINUX)
+    ptedit_range_t range;
+    range.pid = (size_t)pid;
+    range.start = (size_t)start;
+    range.end = (size_t)end;
+    range.count = 0;
+    range.leaves = NULL;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_WATCH, (size_t)&range) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_unwatch() {
+#if defined(LINUX)
+    ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_UNWATCH, 0);
+#else
+    NO_WINDOWS_SUPPORT
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc size_t ptedit_read_events(ptedit_event_t* events, size_t count, int wait) {
+#if defined(LINUX)
+    struct pollfd pfd;
+    ssize_t bytes;
+    pfd.fd = ptedit_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, wait ? -1 : 0) <= 0 || !(pfd.revents & POLLIN)) {
+        return 0;
+    }
+    bytes = read(ptedit_fd, events, count * sizeof(ptedit_event_t));
+    if (bytes <= 0) {
+        return 0;
+    }
+    // the watched page tables changed, cached upper levels may be stale
+    PTEDIT_ATOMIC_INC(ptedit_pwc_gen);
+    return (size_t)bytes / sizeof(ptedit_event_t);
+#else
+    NO_WINDOWS_SUPPORT
+    return 0;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+static int ptedit_attach_ext(pid_t pid, int pidfd, ptedit_target_t* target) {
+#if defined(LINUX)
+    ptedit_attach_t attach;
+    target->fd = open(PTEDITOR_DEVICE_PATH, O_RDONLY);
+    if (target->fd < 0) {
+        return -1;
+    }
+    attach.pid = (size_t)pid;
+    attach.pidfd = pidfd;
+    if (ioctl(target->fd, PTEDITOR_IOCTL_CMD_ATTACH, (size_t)&attach)) {
+        close(target->fd);
+        target->fd = -1;
+        return -1;
+    }
+    target->pid = (pid_t)attach.pid;
+    return 0;
+#else
+    NO_WINDOWS_SUPPORT
+    return -1;
+#endif
+}
 
 // ---------------------------------------------------------------------------
-static ptedit_entry_t ptedit_resolve_user(void* address, pid_t pid) {
-    return ptedit_resolve_user_ext(address, pid, ptedit_phys_read_pread);
+ptedit_fnc int ptedit_attach(pid_t pid, ptedit_target_t* target) {
+    return ptedit_attach_ext(pid, -1, target);
 }
 
-
 // ---------------------------------------------------------------------------
-static ptedit_entry_t ptedit_resolve_user_map(void* address, pid_t pid) {
-    return ptedit_resolve_user_ext(address, pid, ptedit_phys_read_map);
+ptedit_fnc int ptedit_attach_pidfd(int pidfd, ptedit_target_t* target) {
+    if (pidfd < 0) {
+        return -1;
+    }
+    return ptedit_attach_ext(0, pidfd, target);
 }
 
-
 // ---------------------------------------------------------------------------
-ptedit_fnc void ptedit_update_kernel(void* address, pid_t pid, ptedit_entry_t* vm) {
-    vm->vaddr = (size_t)address;
-    vm->pid = (size_t)pid;
+ptedit_fnc void ptedit_detach(ptedit_target_t* target) {
 #if defined(LINUX)
-    ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_UPDATE, (size_t)vm);
-#else 
+    if (target->fd < 0) {
+        return;
+    }
+    ioctl(target->fd, PTEDITOR_IOCTL_CMD_DETACH, 0);
+    close(target->fd);
+    target->fd = -1;
+#else
     NO_WINDOWS_SUPPORT
 #endif
 }
 
 // ---------------------------------------------------------------------------
-ptedit_fnc void ptedit_update_user_ext(void* address, pid_t pid, ptedit_entry_t* vm, ptedit_phys_write_t pset) {
-    ptedit_entry_t current = ptedit_resolve(address, pid);
-    size_t root = (pid == 0) ? ptedit_paging_root : ptedit_get_paging_root(pid);
-    root = root & ~1;
-
-    if(!root) return;
-    
-    size_t pgdi, p4di, pudi, pmdi, pti;
-    size_t addr = (size_t)address;
-    pgdi = (addr >> (ptedit_paging_definition.page_offset
-        + ptedit_paging_definition.pt_entries
-        + ptedit_paging_definition.pmd_entries
-        + ptedit_paging_definition.pud_entries
-        + ptedit_paging_definition.p4d_entries)) % (1ull << ptedit_paging_definition.pgd_entries);
-    p4di = (addr >> (ptedit_paging_definition.page_offset
-        + ptedit_paging_definition.pt_entries
-        + ptedit_paging_definition.pmd_entries
-        + ptedit_paging_definition.pud_entries)) % (1ull << ptedit_paging_definition.p4d_entries);
-    pudi = (addr >> (ptedit_paging_definition.page_offset
-        + ptedit_paging_definition.pt_entries
-        + ptedit_paging_definition.pmd_entries)) % (1ull << ptedit_paging_definition.pud_entries);
-    pmdi = (addr >> (ptedit_paging_definition.page_offset
-        + ptedit_paging_definition.pt_entries)) % (1ull << ptedit_paging_definition.pmd_entries);
-    pti = (addr >> ptedit_paging_definition.page_offset) % (1ull << ptedit_paging_definition.pt_entries);
-
-    if ((vm->valid & PTEDIT_VALID_MASK_PTE) && (current.valid & PTEDIT_VALID_MASK_PTE)) {
-        pset((size_t)ptedit_cast(current.pmd, ptedit_pmd_t).pfn * ptedit_pfn_multiply + pti * ptedit_entry_size, vm->pte);
-    }
-    if ((vm->valid & PTEDIT_VALID_MASK_PMD) && (current.valid & PTEDIT_VALID_MASK_PMD) && ptedit_paging_definition.has_pmd) {
-        pset((size_t)ptedit_cast(current.pud, ptedit_pud_t).pfn * ptedit_pfn_multiply + pmdi * ptedit_entry_size, vm->pmd);
-    }
-    if ((vm->valid & PTEDIT_VALID_MASK_PUD) && (current.valid & PTEDIT_VALID_MASK_PUD) && ptedit_paging_definition.has_pud) {
-        pset((size_t)ptedit_cast(current.p4d, ptedit_p4d_t).pfn * ptedit_pfn_multiply + pudi * ptedit_entry_size, vm->pud);
-    }
-    if ((vm->valid & PTEDIT_VALID_MASK_P4D) && (current.valid & PTEDIT_VALID_MASK_P4D) && ptedit_paging_definition.has_p4d) {
-        pset((size_t)ptedit_cast(current.pgd, ptedit_pgd_t).pfn * ptedit_pfn_multiply + p4di * ptedit_entry_size, vm->p4d);
-    }
-    if ((vm->valid & PTEDIT_VALID_MASK_PGD) && (current.valid & PTEDIT_VALID_MASK_PGD) && ptedit_paging_definition.has_pgd) {
-        pset(root + pgdi * ptedit_entry_size, vm->pgd);
-    }
-
-    ptedit_invalidate_tlb(address);
+ptedit_fnc ptedit_entry_t ptedit_target_resolve(ptedit_target_t* target, void* address) {
+    ptedit_entry_t vm;
+    memset(&vm, 0, sizeof(vm));
+    vm.vaddr = (size_t)address;
+    vm.pid = (size_t)target->pid;
+#if defined(LINUX)
+    ioctl(target->fd, PTEDITOR_IOCTL_CMD_VM_RESOLVE, (size_t)&vm);
+#else
+    NO_WINDOWS_SUPPORT
+#endif
+    return vm;
 }
 
 // ---------------------------------------------------------------------------
-static void ptedit_update_user(void* address, pid_t pid, ptedit_entry_t* vm) {
-    ptedit_update_user_ext(address, pid, vm, ptedit_phys_write_pwrite);
-    ptedit_invalidate_tlb(address);
+ptedit_fnc void ptedit_target_update(ptedit_target_t* target, void* address, ptedit_entry_t* vm) {
+#if defined(LINUX)
+    vm->vaddr = (size_t)address;
+    vm->pid = (size_t)target->pid;
+    ioctl(target->fd, PTEDITOR_IOCTL_CMD_VM_UPDATE, (size_t)vm);
+#else
+    NO_WINDOWS_SUPPORT
+#endif
 }
 
-
 // ---------------------------------------------------------------------------
-static void ptedit_update_user_map(void* address, pid_t pid, ptedit_entry_t* vm) {
-    ptedit_update_user_ext(address, pid, vm, ptedit_phys_write_map);
-    ptedit_invalidate_tlb(address);
+ptedit_fnc size_t ptedit_target_get_paging_root(ptedit_target_t* target) {
+    ptedit_paging_t paging;
+    paging.pid = (size_t)target->pid;
+    paging.root = 0;
+#if defined(LINUX)
+    ioctl(target->fd, PTEDITOR_IOCTL_CMD_GET_ROOT, (size_t)&paging);
+#else
+    NO_WINDOWS_SUPPORT
+#endif
+    return paging.root;
 }
 
 // ---------------------------------------------------------------------------
@@ -302,10 +1190,14 @@ ptedit_fnc void* ptedit_pmap(size_t physical, size_t length) {
 ptedit_fnc size_t ptedit_set_pfn(size_t pte, size_t pfn) {
 #if defined(__i386__) || defined(__x86_64__) || defined(_WIN64)
     pte &= ~(((1ull << 40) - 1) << 12);
+    pte |= pfn << 12;
 #elif defined(__aarch64__)
     pte &= ~(((1ull << 36) - 1) << 12);
-#endif
     pte |= pfn << 12;
+#elif defined(__riscv)
+    pte &= ~(((1ull << 44) - 1) << 10);
+    pte |= pfn << 10;
+#endif
     return pte;
 }
 
@@ -316,6 +1208,8 @@ ptedit_fnc size_t ptedit_get_pfn(size_t pte) {
     return (pte & (((1ull << 40) - 1) << 12)) >> 12;
 #elif defined(__aarch64__)
     return (pte & (((1ull << 36) - 1) << 12)) >> 12;
+#elif defined(__riscv)
+    return (pte & (((1ull << 44) - 1) << 10)) >> 10;
 #endif
 }
 
@@ -383,6 +1277,26 @@ ptedit_fnc void ptedit_print_entry_line(size_t entry, int line) {
         PEDIT_PRINT_B("%d", (PTEDIT_B(entry, 1) << 1) | PTEDIT_B(entry, 0));
         printf("\n");
     }
+#elif defined(__riscv)
+    if (line == 0 || line == 3) printf("+-+--+--+------------------+--+-+-+-+-+-+-+-+-+\n");
+    if (line == 1) printf("|N|MT| ?|       PFN        |SW|D|A|G|U|X|W|R|V|\n");
+    if (line == 2) {
+        printf("|");
+        PEDIT_PRINT_B("%d", PTEDIT_B(entry, PTEDIT_PAGE_BIT_NAPOT));
+        PEDIT_PRINT_B("%2d", (PTEDIT_B(entry, PTEDIT_PAGE_BIT_PBMT_BIT1) << 1) | PTEDIT_B(entry, PTEDIT_PAGE_BIT_PBMT_BIT0));
+        PEDIT_PRINT_B("%2d", !!((entry >> 54) & 0x7f));
+        printf(" %16p |", (void*)((entry >> 10) & ((1ull << 44) - 1)));
+        PEDIT_PRINT_B("%2d", (PTEDIT_B(entry, PTEDIT_PAGE_BIT_SOFTW2) << 1) | PTEDIT_B(entry, PTEDIT_PAGE_BIT_SOFTW1));
+        PEDIT_PRINT_B("%d", PTEDIT_B(entry, PTEDIT_PAGE_BIT_DIRTY));
+        PEDIT_PRINT_B("%d", PTEDIT_B(entry, PTEDIT_PAGE_BIT_ACCESSED));
+        PEDIT_PRINT_B("%d", PTEDIT_B(entry, PTEDIT_PAGE_BIT_GLOBAL));
+        PEDIT_PRINT_B("%d", PTEDIT_B(entry, PTEDIT_PAGE_BIT_USER));
+        PEDIT_PRINT_B("%d", PTEDIT_B(entry, PTEDIT_PAGE_BIT_EXEC));
+        PEDIT_PRINT_B("%d", PTEDIT_B(entry, PTEDIT_PAGE_BIT_RW));
+        PEDIT_PRINT_B("%d", PTEDIT_B(entry, PTEDIT_PAGE_BIT_READ));
+        PEDIT_PRINT_B("%d", PTEDIT_B(entry, PTEDIT_PAGE_BIT_PRESENT));
+        printf("\n");
+    }
 #endif
 }
 
@@ -417,6 +1331,9 @@ ptedit_fnc void ptedit_print_entry_t(ptedit_entry_t entry) {
         printf("PTE of address\n");
         ptedit_print_entry(entry.pte);
     }
+    if (entry.page_size) {
+        printf("Mapped by a %zu KB page\n", entry.page_size / 1024);
+    }
 }
 
 // ---------------------------------------------------------------------------
@@ -436,12 +1353,6 @@ ptedit_fnc int ptedit_init() {
     }
     ptedit_umem = 0;
 #endif
-#if defined(LINUX)
-    ptedit_use_implementation(PTEDIT_IMPL_KERNEL);
-#elif defined(WINDOWS)
-    ptedit_use_implementation(PTEDIT_IMPL_USER_PREAD);
-#endif
-    //   }
 #if defined(LINUX)
     ptedit_pagesize = getpagesize();
 #else
@@ -460,6 +1371,11 @@ ptedit_fnc int ptedit_init() {
     ptedit_paging_definition.pmd_entries = 9;
     ptedit_paging_definition.pt_entries = 9;
     ptedit_paging_definition.page_offset = 12;
+    if (ptedit_get_paging_levels() == 5) {
+        // LA57, the PGD is the PML5 and the P4D the PML4
+        ptedit_paging_definition.has_p4d = 1;
+        ptedit_paging_definition.p4d_entries = 9;
+    }
 #elif defined(__aarch64__)
     if(ptedit_get_pagesize() == 16384) {
         ptedit_paging_definition.has_pgd = 1;
@@ -473,7 +1389,6 @@ ptedit_fnc int ptedit_init() {
         ptedit_paging_definition.pmd_entries = 11;
         ptedit_paging_definition.pt_entries = 11;
         ptedit_paging_definition.page_offset = 14;
-        ptedit_use_implementation(PTEDIT_IMPL_USER_PREAD); // M1 workaround
     } else {
         ptedit_paging_definition.has_pgd = 1;
         ptedit_paging_definition.has_p4d = 0;
@@ -486,6 +1401,39 @@ ptedit_fnc int ptedit_init() {
         ptedit_paging_definition.pmd_entries = 9;
         ptedit_paging_definition.pt_entries = 9;
         ptedit_paging_definition.page_offset = 12;
+        if (ptedit_get_paging_levels() == 4) {
+            // 48-bit virtual addresses
+            ptedit_paging_definition.has_pud = 1;
+            ptedit_paging_definition.pud_entries = 9;
+        }
+    }
+#elif defined(__riscv)
+    // Sv39 (3 levels), Sv48 (4 levels), or Sv57 (5 levels), depending on the satp mode
+    int levels = ptedit_get_paging_levels();
+    ptedit_paging_definition.has_pgd = 1;
+    ptedit_paging_definition.has_p4d = (levels == 5);
+    ptedit_paging_definition.has_pud = (levels >= 4);
+    ptedit_paging_definition.has_pmd = 1;
+    ptedit_paging_definition.has_pt = 1;
+    ptedit_paging_definition.pgd_entries = 9;
+    ptedit_paging_definition.p4d_entries = (levels == 5) ? 9 : 0;
+    ptedit_paging_definition.pud_entries = (levels >= 4) ? 9 : 0;
+    ptedit_paging_definition.pmd_entries = 9;
+    ptedit_paging_definition.pt_entries = 9;
+    ptedit_paging_definition.page_offset = 12;
+#endif
+
+    ptedit_select_walker();
+    ptedit_select_filter();
+
+#if defined(LINUX)
+    ptedit_use_implementation(PTEDIT_IMPL_KERNEL);
+#elif defined(WINDOWS)
+    ptedit_use_implementation(PTEDIT_IMPL_USER_PREAD);
+#endif
+#if defined(__aarch64__)
+    if (ptedit_paging_definition.page_offset == 14) {
+        ptedit_use_implementation(PTEDIT_IMPL_USER_PREAD); // M1 workaround
     }
 #endif
     return 0;
@@ -495,6 +1443,7 @@ ptedit_fnc int ptedit_init() {
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_cleanup() {
 #if defined(LINUX)
+    ptedit_async_cleanup();
     if (ptedit_fd >= 0) {
         close(ptedit_fd);
     }
@@ -509,23 +1458,30 @@ ptedit_fnc void ptedit_cleanup() {
 
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_use_implementation(int implementation) {
+    ptedit_pwc_invalidate();
     if (implementation == PTEDIT_IMPL_KERNEL) {
 #if defined(LINUX)
         ptedit_resolve = ptedit_resolve_kernel;
         ptedit_update = ptedit_update_kernel;
+        ptedit_resolve_batch = ptedit_resolve_batch_kernel;
+        ptedit_update_batch = ptedit_update_batch_kernel;
 #else
         fprintf(stderr, PTEDIT_COLOR_RED "[-]" PTEDIT_COLOR_RESET "Error: PTEditor implementation not supported on Windows");
 #endif
     }
     else if (implementation == PTEDIT_IMPL_USER_PREAD) {
-        ptedit_resolve = ptedit_resolve_user;
+        ptedit_resolve = ptedit_resolve_user_walk;
         ptedit_update = ptedit_update_user;
+        ptedit_resolve_batch = ptedit_resolve_batch_user;
+        ptedit_update_batch = ptedit_update_batch_user;
         ptedit_paging_root = ptedit_get_paging_root(0);
     }
     else if (implementation == PTEDIT_IMPL_USER) {
 #if defined(LINUX)
-        ptedit_resolve = ptedit_resolve_user_map;
+        ptedit_resolve = ptedit_resolve_user_map_walk;
         ptedit_update = ptedit_update_user_map;
+        ptedit_resolve_batch = ptedit_resolve_batch_user;
+        ptedit_update_batch = ptedit_update_batch_user;
         ptedit_paging_root = ptedit_get_paging_root(0);
         if (!ptedit_vmem) {
             ptedit_vmem = (unsigned char*)mmap(NULL, 32ull << 30ull, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, ptedit_umem, 0);
@@ -541,6 +1497,17 @@ ptedit_fnc void ptedit_use_implementation(int implementation) {
 }
 
 
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_pwc_enable(int enable) {
+    ptedit_pwc_enabled = enable;
+    ptedit_pwc_invalidate();
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_pwc_invalidate() {
+    PTEDIT_ATOMIC_INC(ptedit_pwc_gen);
+}
+
 // ---------------------------------------------------------------------------
 ptedit_fnc int ptedit_get_pagesize() {
 #if defined(LINUX)
@@ -553,6 +1520,28 @@ ptedit_fnc int ptedit_get_pagesize() {
 }
 
 
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_get_paging_levels() {
+#if defined(LINUX)
+    return (int)ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_GET_PAGING_LEVELS, 0);
+#else
+    // the driver does not support 5-level paging
+    return 4;
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_get_stats(ptedit_stats_t* stats) {
+#if defined(LINUX)
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_GET_STATS, (size_t)stats) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT
+    return -1;
+#endif
+}
+
+
 // ---------------------------------------------------------------------------
 ptedit_fnc void ptedit_read_physical_page(size_t pfn, char* buffer) {
 #if defined(LINUX)
@@ -603,6 +1592,36 @@ ptedit_fnc void ptedit_write_physical_page(size_t pfn, char* content) {
 }
 
 
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_read_physical_pages(ptedit_page_t* pages, size_t count) {
+#if defined(LINUX)
+    ptedit_batch_t batch;
+    batch.pid = 0;
+    batch.count = count;
+    batch.data = pages;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_READ_PAGES, (size_t)&batch) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT
+    return -1;
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_write_physical_pages(ptedit_page_t* pages, size_t count) {
+#if defined(LINUX)
+    ptedit_batch_t batch;
+    batch.pid = 0;
+    batch.count = count;
+    batch.data = pages;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_WRITE_PAGES, (size_t)&batch) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT
+    return -1;
+#endif
+}
+
+
 // ---------------------------------------------------------------------------
 size_t ptedit_get_paging_root(pid_t pid) {
 #if defined(LINUX)
@@ -626,6 +1645,7 @@ void ptedit_set_paging_root(pid_t pid, size_t root) {
     ptedit_paging_t cr3;
     cr3.pid = (size_t)pid;
     cr3.root = root; 
+    ptedit_pwc_invalidate();
 #if defined(LINUX)
     ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_SET_ROOT, (size_t)&cr3);
 #else
@@ -650,6 +1670,25 @@ ptedit_fnc void ptedit_invalidate_tlb(void* address) {
 #endif
 }
 
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_invalidate_tlb_range(pid_t pid, void* start, void* end) {
+#if defined(LINUX)
+    ptedit_range_t range;
+    range.pid = (size_t)pid;
+    range.start = (size_t)start;
+    range.end = (size_t)end;
+    range.count = 0;
+    range.leaves = NULL;
+    ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_INVALIDATE_TLB_RANGE, (size_t)&range);
+#else
+    size_t vaddr;
+    (void)pid;
+    for (vaddr = (size_t)start; vaddr < (size_t)end; vaddr += ptedit_pagesize) {
+        ptedit_invalidate_tlb((void*)vaddr);
+    }
+#endif
+}
+
 // ---------------------------------------------------------------------------
 ptedit_fnc int ptedit_switch_tlb_invalidation(int implementation) {
 #if defined(LINUX)
@@ -678,7 +1717,7 @@ ptedit_fnc char ptedit_get_mt(unsigned char mt) {
     size_t mts = ptedit_get_mts();
 #if defined(__i386__) || defined(__x86_64__) || defined(_WIN64)
     return ((mts >> (mt * 8)) & 7);
-#elif defined(__aarch64__)
+#elif defined(__aarch64__) || defined(__riscv)
     return ((mts >> (mt * 8)) & 0xff);
 #endif
 }
@@ -728,6 +1767,10 @@ const char* ptedit_mt_to_string(unsigned char mt) {
         }
     }
     return mts;
+#elif defined(__riscv)
+    const char* mts[] = { "WB", "NC", "IO", "Rsvd" };
+    if (mt <= 3) return mts[mt];
+    return NULL;
 #endif
 }
 
@@ -748,7 +1791,7 @@ ptedit_fnc void ptedit_set_mt(unsigned char mt, unsigned char value) {
     size_t mts = ptedit_get_mts();
 #if defined(__i386__) || defined(__x86_64__) || defined(_WIN64)
     mts &= ~(7 << (mt * 8));
-#elif defined(__aarch64__)
+#elif defined(__aarch64__) || defined(__riscv)
     mts &= ~(0xff << (mt * 8));
 #endif
     mts |= ((size_t)value << (mt * 8));
@@ -776,6 +1819,8 @@ ptedit_fnc unsigned char ptedit_find_mt(unsigned char type) {
                 found |= (1 << i);
             }
         }
+#elif defined(__riscv)
+        if (i < 3 && ((mts >> (i * 8)) & 0xff) == type) found |= (1 << i);
 #endif
     }
     return found;
@@ -808,6 +1853,9 @@ ptedit_fnc size_t ptedit_apply_mt(size_t entry, unsigned char mt) {
 #elif defined(__aarch64__)
     entry &= ~0x1c;
     entry |= (mt & 7) << 2;
+#elif defined(__riscv)
+    entry &= ~(3ull << PTEDIT_PAGE_BIT_PBMT_BIT0);
+    entry |= (size_t)(mt & 3) << PTEDIT_PAGE_BIT_PBMT_BIT0;
 #endif
     return entry;
 }
@@ -822,6 +1870,9 @@ size_t ptedit_apply_mt_huge(size_t entry, unsigned char mt) {
 #elif defined(__aarch64__)
     entry &= ~0x1c;
     entry |= (mt & 7) << 2;
+#elif defined(__riscv)
+    entry &= ~(3ull << PTEDIT_PAGE_BIT_PBMT_BIT0);
+    entry |= (size_t)(mt & 3) << PTEDIT_PAGE_BIT_PBMT_BIT0;
 #endif
     return entry;
 }
@@ -832,6 +1883,8 @@ ptedit_fnc unsigned char ptedit_extract_mt(size_t entry) {
     return (!!(entry & (1ull << PTEDIT_PAGE_BIT_PWT))) | ((!!(entry & (1ull << PTEDIT_PAGE_BIT_PCD))) << 1) | ((!!(entry & (1ull << PTEDIT_PAGE_BIT_PAT))) << 2);
 #elif defined(__aarch64__)
     return (entry >> 2) & 7;
+#elif defined(__riscv)
+    return (entry >> PTEDIT_PAGE_BIT_PBMT_BIT0) & 3;
 #endif
 }
 
@@ -841,6 +1894,8 @@ unsigned char ptedit_extract_mt_huge(size_t entry) {
     return (!!(entry & (1ull << PTEDIT_PAGE_BIT_PWT))) | ((!!(entry & (1ull << PTEDIT_PAGE_BIT_PCD))) << 1) | ((!!(entry & (1ull << PTEDIT_PAGE_BIT_PAT_LARGE))) << 2);
 #elif defined(__aarch64__)
     return (entry >> 2) & 7;
+#elif defined(__riscv)
+    return (entry >> PTEDIT_PAGE_BIT_PBMT_BIT0) & 3;
 #endif
 }
 
@@ -856,6 +1911,8 @@ ptedit_fnc void ptedit_full_serializing_barrier() {
     asm volatile("DSB SY");
     asm volatile("DSB ISH");
     asm volatile("ISB");
+#elif defined(__riscv)
+    asm volatile("fence iorw, iorw" ::: "memory");
 #endif
     ptedit_set_paging_root(0, ptedit_get_paging_root(0));
 #if defined(__i386__) || defined(__x86_64__) || defined(_WIN64)
@@ -868,6 +1925,220 @@ ptedit_fnc void ptedit_full_serializing_barrier() {
     asm volatile("ISB");
     asm volatile("DSB ISH");
     asm volatile("DSB SY");
+#elif defined(__riscv)
+    asm volatile("fence iorw, iorw" ::: "memory");
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_async_init(unsigned int entries) {
+#if defined(PTEDIT_HAS_IO_URING)
+    struct io_uring_params params;
+    if (ptedit_ring.initialized) {
+        return 0;
+    }
+    memset(&params, 0, sizeof(params));
+    ptedit_ring.fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ptedit_ring.fd < 0) {
+        return -1;
+    }
+    ptedit_ring.initialized = 1;
+    ptedit_ring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ptedit_ring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ptedit_ring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ptedit_ring.sq_ring = mmap(NULL, ptedit_ring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ptedit_ring.fd, IORING_OFF_SQ_RING);
+    ptedit_ring.cq_ring = mmap(NULL, ptedit_ring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ptedit_ring.fd, IORING_OFF_CQ_RING);
+    ptedit_ring.sqes = (struct io_uring_sqe*)mmap(NULL, ptedit_ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ptedit_ring.fd, IORING_OFF_SQES);
+    if (ptedit_ring.sq_ring == MAP_FAILED || ptedit_ring.cq_ring == MAP_FAILED || ptedit_ring.sqes == MAP_FAILED) {
+        ptedit_async_cleanup();
+        return -1;
+    }
+    ptedit_ring.sq_head = (unsigned*)((char*)ptedit_ring.sq_ring + params.sq_off.head);
+    ptedit_ring.sq_tail = (unsigned*)((char*)ptedit_ring.sq_ring + params.sq_off.tail);
+    ptedit_ring.sq_mask = (unsigned*)((char*)ptedit_ring.sq_ring + params.sq_off.ring_mask);
+    ptedit_ring.sq_array = (unsigned*)((char*)ptedit_ring.sq_ring + params.sq_off.array);
+    ptedit_ring.cq_head = (unsigned*)((char*)ptedit_ring.cq_ring + params.cq_off.head);
+    ptedit_ring.cq_tail = (unsigned*)((char*)ptedit_ring.cq_ring + params.cq_off.tail);
+    ptedit_ring.cq_mask = (unsigned*)((char*)ptedit_ring.cq_ring + params.cq_off.ring_mask);
+    ptedit_ring.cqes = (struct io_uring_cqe*)((char*)ptedit_ring.cq_ring + params.cq_off.cqes);
+    ptedit_ring.queued = 0;
+    return 0;
+#else
+    (void)entries;
+    return -1;
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc void ptedit_async_cleanup() {
+#if defined(PTEDIT_HAS_IO_URING)
+    if (!ptedit_ring.initialized) {
+        return;
+    }
+    if (ptedit_ring.sq_ring && ptedit_ring.sq_ring != MAP_FAILED) {
+        munmap(ptedit_ring.sq_ring, ptedit_ring.sq_ring_size);
+    }
+    if (ptedit_ring.cq_ring && ptedit_ring.cq_ring != MAP_FAILED) {
+        munmap(ptedit_ring.cq_ring, ptedit_ring.cq_ring_size);
+    }
+    if (ptedit_ring.sqes && ptedit_ring.sqes != MAP_FAILED) {
+        munmap(ptedit_ring.sqes, ptedit_ring.sqes_size);
+    }
+    close(ptedit_ring.fd);
+    memset(&ptedit_ring, 0, sizeof(ptedit_ring));
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_async_submit() {
+#if defined(PTEDIT_HAS_IO_URING)
+    int submitted;
+    if (!ptedit_ring.initialized) {
+        return -1;
+    }
+    if (!ptedit_ring.queued) {
+        return 0;
+    }
+    submitted = (int)syscall(__NR_io_uring_enter, ptedit_ring.fd, ptedit_ring.queued, 0, 0, NULL, 0);
+    if (submitted < 0) {
+        return -1;
+    }
+    ptedit_ring.queued -= submitted;
+    return submitted;
+#else
+    return -1;
+#endif
+}
+
+
+#if defined(PTEDIT_HAS_IO_URING)
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_async_queue(unsigned int cmd, size_t param, size_t user_data) {
+    unsigned tail, index;
+    struct io_uring_sqe* sqe;
+    if (!ptedit_ring.initialized) {
+        return -1;
+    }
+    tail = *ptedit_ring.sq_tail;
+    if (tail - __atomic_load_n(ptedit_ring.sq_head, __ATOMIC_ACQUIRE) > *ptedit_ring.sq_mask) {
+        /* Submission queue is full, hand the queued commands to the kernel first */
+        if (ptedit_async_submit() <= 0 || tail - __atomic_load_n(ptedit_ring.sq_head, __ATOMIC_ACQUIRE) > *ptedit_ring.sq_mask) {
+            return -1;
+        }
+    }
+    index = tail & *ptedit_ring.sq_mask;
+    sqe = &ptedit_ring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_URING_CMD;
+    sqe->fd = ptedit_fd;
+    sqe->cmd_op = cmd;
+    sqe->user_data = user_data;
+    /* The command area of the SQE holds the ioctl parameter */
+    memcpy(&sqe->addr3, &param, sizeof(param));
+    ptedit_ring.sq_array[index] = index;
+    __atomic_store_n(ptedit_ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ptedit_ring.queued++;
+    return 0;
+}
+#endif
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_async_resolve(void* address, pid_t pid, ptedit_entry_t* entry, size_t user_data) {
+#if defined(PTEDIT_HAS_IO_URING)
+    memset(entry, 0, sizeof(ptedit_entry_t));
+    entry->vaddr = (size_t)address;
+    entry->pid = (size_t)pid;
+    return ptedit_async_queue(PTEDITOR_IOCTL_CMD_VM_RESOLVE, (size_t)entry, user_data);
+#else
+    (void)address; (void)pid; (void)entry; (void)user_data;
+    return -1;
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_async_update(void* address, pid_t pid, ptedit_entry_t* vm, size_t user_data) {
+#if defined(PTEDIT_HAS_IO_URING)
+    vm->vaddr = (size_t)address;
+    vm->pid = (size_t)pid;
+    return ptedit_async_queue(PTEDITOR_IOCTL_CMD_VM_UPDATE, (size_t)vm, user_data);
+#else
+    (void)address; (void)pid; (void)vm; (void)user_data;
+    return -1;
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_async_read_physical_page(ptedit_page_t* page, size_t user_data) {
+#if defined(PTEDIT_HAS_IO_URING)
+    return ptedit_async_queue(PTEDITOR_IOCTL_CMD_READ_PAGE, (size_t)page, user_data);
+#else
+    (void)page; (void)user_data;
+    return -1;
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_async_write_physical_page(ptedit_page_t* page, size_t user_data) {
+#if defined(PTEDIT_HAS_IO_URING)
+    return ptedit_async_queue(PTEDITOR_IOCTL_CMD_WRITE_PAGE, (size_t)page, user_data);
+#else
+    (void)page; (void)user_data;
+    return -1;
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_async_invalidate_tlb(void* address, size_t user_data) {
+#if defined(PTEDIT_HAS_IO_URING)
+    return ptedit_async_queue(PTEDITOR_IOCTL_CMD_INVALIDATE_TLB, (size_t)address, user_data);
+#else
+    (void)address; (void)user_data;
+    return -1;
+#endif
+}
+
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_async_complete(size_t* user_data, int* result, int wait) {
+#if defined(PTEDIT_HAS_IO_URING)
+    unsigned head;
+    struct io_uring_cqe* cqe;
+    if (!ptedit_ring.initialized) {
+        return -1;
+    }
+    head = *ptedit_ring.cq_head;
+    while (head == __atomic_load_n(ptedit_ring.cq_tail, __ATOMIC_ACQUIRE)) {
+        int submitted;
+        if (!wait) {
+            return 0;
+        }
+        /* Submits the remaining commands and waits for at least one completion */
+        submitted = (int)syscall(__NR_io_uring_enter, ptedit_ring.fd, ptedit_ring.queued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted < 0) {
+            return -1;
+        }
+        ptedit_ring.queued -= submitted;
+    }
+    cqe = &ptedit_ring.cqes[head & *ptedit_ring.cq_mask];
+    if (user_data) {
+        *user_data = (size_t)cqe->user_data;
+    }
+    if (result) {
+        *result = cqe->res;
+    }
+    __atomic_store_n(ptedit_ring.cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+#else
+    (void)user_data; (void)result; (void)wait;
+    return -1;
 #endif
 }
 
@@ -946,6 +2217,33 @@ ptedit_fnc void ptedit_clear_bit(void* address, pid_t pid, int bit,size_t paging
     ptedit_update(address, pid, &vm);
 }
 
+// ---------------------------------------------------------------------------
+static int ptedit_bit_range(pid_t pid, void* start, void* end, int bit, size_t paging_affected_levels, int set) {
+#if defined(LINUX)
+    ptedit_bits_t bits;
+    bits.pid = (size_t)pid;
+    bits.start = (size_t)start;
+    bits.end = (size_t)end;
+    bits.bit = (size_t)bit;
+    bits.set = (size_t)set;
+    bits.levels = paging_affected_levels;
+    return ioctl(ptedit_fd, PTEDITOR_IOCTL_CMD_VM_BITS, (size_t)&bits) ? -1 : 0;
+#else
+    NO_WINDOWS_SUPPORT
+    return -1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_set_bit_range(pid_t pid, void* start, void* end, int bit, size_t paging_affected_levels) {
+    return ptedit_bit_range(pid, start, end, bit, paging_affected_levels, 1);
+}
+
+// ---------------------------------------------------------------------------
+ptedit_fnc int ptedit_clear_bit_range(pid_t pid, void* start, void* end, int bit, size_t paging_affected_levels) {
+    return ptedit_bit_range(pid, start, end, bit, paging_affected_levels, 0);
+}
+
 // ---------------------------------------------------------------------------
 ptedit_fnc unsigned char ptedit_pte_get_bit(void* address, pid_t pid, int bit) {
     ptedit_entry_t vm = ptedit_resolve(address, pid);
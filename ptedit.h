@@ -130,6 +130,35 @@ typedef size_t pid_t;
 /** Available for programmer */
 #define PTEDIT_PAGE_BIT_SOFTW9 63
 
+#elif defined(__riscv)
+
+ /** Page is present (valid) */
+#define PTEDIT_PAGE_BIT_PRESENT 0
+/** Page is readable */
+#define PTEDIT_PAGE_BIT_READ 1
+/** Page is writeable */
+#define PTEDIT_PAGE_BIT_RW 2
+/** Page is executable */
+#define PTEDIT_PAGE_BIT_EXEC 3
+/** Page is userspace addressable */
+#define PTEDIT_PAGE_BIT_USER 4
+/** Global TLB entry */
+#define PTEDIT_PAGE_BIT_GLOBAL 5
+/** Page was accessed (raised by CPU) */
+#define PTEDIT_PAGE_BIT_ACCESSED 6
+/** Page was written to (raised by CPU) */
+#define PTEDIT_PAGE_BIT_DIRTY 7
+/** Available for programmer */
+#define PTEDIT_PAGE_BIT_SOFTW1 8
+/** Available for programmer */
+#define PTEDIT_PAGE_BIT_SOFTW2 9
+/** Page-based memory type 1/2 (Svpbmt) */
+#define PTEDIT_PAGE_BIT_PBMT_BIT0 61
+/** Page-based memory type 2/2 (Svpbmt) */
+#define PTEDIT_PAGE_BIT_PBMT_BIT1 62
+/** Naturally aligned power-of-2 mapping (Svnapot) */
+#define PTEDIT_PAGE_BIT_NAPOT 63
+
 #endif
 /** @} */
 
@@ -164,6 +193,15 @@ typedef size_t pid_t;
 /** Write back (read and write accesses are cached) */
 #define PTEDIT_MT_WB      0xff
 
+#elif defined(__riscv)
+
+ /** Write back, i.e., the physical memory attributes (Svpbmt PMA) */
+#define PTEDIT_MT_WB      0
+/** Non-cacheable, idempotent, weakly-ordered (Svpbmt NC) */
+#define PTEDIT_MT_WC      1
+/** Strong uncachable, i.e., non-cacheable, non-idempotent, strongly-ordered (Svpbmt IO) */
+#define PTEDIT_MT_UC      2
+
 #endif
 /** @} */
 
@@ -198,6 +236,26 @@ ptedit_fnc void ptedit_cleanup();
  */
 ptedit_fnc void ptedit_use_implementation(int implementation);
 
+/**
+ * Enables or disables the paging-structure cache of the user-space implementations
+ *
+ * With the cache enabled, the upper-level entries (PGD to PMD) of a page walk are kept and reused for all addresses sharing them,
+ * so that resolving neighbouring addresses only reads the PTE. The cache is invalidated whenever upper levels are updated
+ * through PTEditor, the paging root changes, or change events are read. Other modifications of the address space (e.g., munmap)
+ * require an explicit invalidation using ptedit_pwc_invalidate. Updates and ptedit_resolve_locations always walk all levels.
+ * Every thread has its own cache, invalidations apply to the caches of all threads.
+ *
+ * @param[in] enable 1 to enable the cache, 0 to disable it
+ *
+ */
+ptedit_fnc void ptedit_pwc_enable(int enable);
+
+/**
+ * Invalidates all entries of the paging-structure cache
+ *
+ */
+ptedit_fnc void ptedit_pwc_invalidate();
+
 /** @} */
 
 
@@ -213,10 +271,13 @@ ptedit_fnc void ptedit_use_implementation(int implementation);
 
 typedef ptedit_entry_t(*ptedit_resolve_t)(void*, pid_t);
 typedef void (*ptedit_update_t)(void*, pid_t, ptedit_entry_t*);
+typedef void (*ptedit_resolve_batch_t)(ptedit_entry_t*, size_t, pid_t);
+typedef void (*ptedit_update_batch_t)(ptedit_entry_t*, size_t, pid_t);
 
 
 /**
  * Resolves the page-table entries of all levels for a virtual address of a given process.
+ * The walk stops at the leaf entry, its level and the number of bytes it maps (e.g., 2 MB for a huge page) are returned in level and page_size.
  *
  * @param[in] address The virtual address to resolve
  * @param[in] pid The pid of the process (0 for own process)
@@ -236,6 +297,280 @@ ptedit_fnc ptedit_resolve_t ptedit_resolve;
  */
 ptedit_fnc ptedit_update_t ptedit_update;
 
+/**
+ * Resolves the page-table entries of all levels for multiple virtual addresses of a given process.
+ * With the kernel implementation, all addresses are resolved with a single request to the kernel.
+ *
+ * @param[in,out] entries An array of structures, the virtual address to resolve is taken from the vaddr field of each entry
+ * @param[in] count The number of entries
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ */
+ptedit_fnc ptedit_resolve_batch_t ptedit_resolve_batch;
+
+/**
+ * Updates one or more page-table entries for multiple virtual addresses of a given process.
+ * With the kernel implementation, all entries are updated with a single request to the kernel, and the TLB is flushed only once
+ * after all entries are updated. If the batch is larger than the flush ceiling of the kernel module (module parameter tlb_flush_ceiling),
+ * the entire TLB is flushed instead of the individual addresses.
+ *
+ * @param[in] entries An array of structures containing the virtual address, the values for the page-table entries, and a bitmask indicating which entries to update
+ * @param[in] count The number of entries
+ * @param[in] pid The pid of the process (0 for own process)
+ *
+ */
+ptedit_fnc ptedit_update_batch_t ptedit_update_batch;
+
+/**
+ * Physical addresses of the page-table entries of all levels for a virtual address
+ */
+typedef struct {
+    /** Physical address of the page global directory entry */
+    size_t pgd;
+    /** Physical address of the page directory 4 entry */
+    size_t p4d;
+    /** Physical address of the page upper directory entry */
+    size_t pud;
+    /** Physical address of the page middle directory entry */
+    size_t pmd;
+    /** Physical address of the page table entry */
+    size_t pte;
+    /** Bitmask indicating which locations are valid */
+    size_t valid;
+} ptedit_location_t;
+
+/**
+ * Resolves the page-table entries of all levels for a virtual address of a given process, and records the physical address of each entry.
+ * The locations can be passed to ptedit_update_locations to update the entries without walking the page tables again.
+ *
+ * @param[in] address The virtual address to resolve
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[out] location The physical addresses of the resolved entries
+ *
+ * @return A structure containing the page-table entries of all levels.
+ */
+ptedit_fnc ptedit_entry_t ptedit_resolve_locations(void* address, pid_t pid, ptedit_location_t* location);
+
+/**
+ * Updates one or more page-table entries at the locations retrieved with ptedit_resolve_locations.
+ * With the user-space implementations, the entries are written directly without a page walk, and the TLB for the given address is flushed once.
+ * With the kernel implementation, this is the same as ptedit_update.
+ *
+ * @param[in] address The virtual address
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] vm A structure containing the values for the page-table entries and a bitmask indicating which entries to update
+ * @param[in] location The physical addresses of the entries as retrieved with ptedit_resolve_locations
+ *
+ */
+ptedit_fnc void ptedit_update_locations(void* address, pid_t pid, ptedit_entry_t* vm, ptedit_location_t* location);
+
+/**
+ * Predicate for ptedit_filter_table. An entry matches if (entry & mask) == value and its PFN is within [pfn_min, pfn_max]
+ */
+typedef struct {
+    /** Bits of the entry which are compared */
+    size_t mask;
+    /** Expected value of the compared bits */
+    size_t value;
+    /** Smallest matching PFN */
+    size_t pfn_min;
+    /** Largest matching PFN, (size_t)-1 for no limit */
+    size_t pfn_max;
+} ptedit_filter_t;
+
+/**
+ * Finds all entries of a page table (or any array of entries) matching a predicate.
+ * Depending on the CPU, blocks of 64 entries are evaluated with AVX-512, AVX2, or NEON instructions, with a scalar fallback.
+ *
+ * @param[in] entries The entries, e.g., a page table read with ptedit_read_physical_page
+ * @param[in] count The number of entries
+ * @param[in] filter The predicate
+ * @param[out] bitmap A bitmap with one bit per entry which is set if the entry matches (may be NULL)
+ * @param[out] indices The indices of all matching entries, must be able to hold count indices (may be NULL)
+ *
+ * @return The number of matching entries
+ */
+ptedit_fnc size_t ptedit_filter_table(size_t* entries, size_t count, ptedit_filter_t* filter, unsigned char* bitmap, size_t* indices);
+
+/**
+ * Retrieves all present leaf entries (i.e., entries mapping a page) of a virtual address range of a given process.
+ * The page tables are walked by the kernel, thus a single call can retrieve many leaf entries.
+ * If the buffer is too small for all leaf entries of the range, the start address is updated to the address where
+ * a subsequent call has to continue. The dump is complete if the start address is not smaller than the end address.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in,out] start The start of the range, updated to the address where the next dump continues
+ * @param[in] end The end of the range (exclusive)
+ * @param[out] leaves A buffer for the leaf entries
+ * @param[in] count The number of leaf entries the buffer can hold
+ *
+ * @return The number of leaf entries written to the buffer
+ */
+ptedit_fnc size_t ptedit_dump_range(pid_t pid, size_t* start, size_t end, ptedit_leaf_t* leaves, size_t count);
+
+/** Also report non-present, non-zero entries of present page tables, e.g., of swapped-out pages */
+#define PTEDIT_WALK_NONPRESENT (1<<0)
+
+/**
+ * Callback for ptedit_walk_range, called for every leaf entry
+ *
+ * @param[in] leaf The entry, its virtual address, its level, and the size of the memory it maps
+ * @param[in] ctx The context passed to ptedit_walk_range
+ *
+ * @return 0 to continue the walk, any other value stops it
+ */
+typedef int (*ptedit_walk_callback_t)(ptedit_leaf_t* leaf, void* ctx);
+
+/**
+ * Walks the page tables of a virtual address range of a given process in user space and calls the callback for every present leaf entry.
+ * Every page table is read only once, either directly through the mapped physical memory (PTEDIT_IMPL_USER) or with a single read of the page.
+ * Subtrees of non-present entries are skipped, and huge pages are reported once with their actual size.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] start The start of the range
+ * @param[in] end The end of the range (exclusive)
+ * @param[in] flags 0 or PTEDIT_WALK_NONPRESENT
+ * @param[in] callback The function called for every entry
+ * @param[in] ctx An arbitrary pointer passed to the callback
+ *
+ * @return 0 Walk was successful (or stopped by the callback)
+ * @return -1 Walk failed
+ */
+ptedit_fnc int ptedit_walk_range(pid_t pid, void* start, void* end, int flags, ptedit_walk_callback_t callback, void* ctx);
+
+/**
+ * Walks the page tables of a virtual address range of a given process with multiple threads, see ptedit_walk_range.
+ * The range is split into tasks of PUD granularity, which are distributed over the threads. Threads that run out of tasks steal tasks of other threads.
+ * The callback is called concurrently, each thread passes its own context, so that results can be collected per thread and merged afterwards without locks.
+ * The walk is fastest with PTEDIT_IMPL_USER, as page tables are then read directly from the mapped physical memory.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] start The start of the range
+ * @param[in] end The end of the range (exclusive)
+ * @param[in] flags 0 or PTEDIT_WALK_NONPRESENT
+ * @param[in] callback The function called for every entry
+ * @param[in] ctx An array of one context per thread, thread i passes ctx[i] to the callback (may be NULL)
+ * @param[in] threads The number of threads, including the calling thread
+ *
+ * @return 0 Walk was successful (or stopped by a callback)
+ * @return -1 Walk failed
+ */
+ptedit_fnc int ptedit_walk_range_parallel(pid_t pid, void* start, void* end, int flags, ptedit_walk_callback_t callback, void** ctx, int threads);
+
+/**
+ * Retrieves the accessed and dirty bits of all pages of a virtual address range of a given process as bitmaps.
+ * The page tables are walked once by the kernel. Optionally, the bits are cleared atomically, followed by a single TLB flush for the range.
+ * Pages mapped by huge pages are reported with the bits of the huge page. Bits of hugetlbfs pages are not cleared.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] start The start of the range (page aligned)
+ * @param[in] end The end of the range (exclusive)
+ * @param[out] accessed A bitmap receiving the accessed bits, bit i % 64 of word i / 64 corresponds to the i-th page (can be NULL)
+ * @param[out] dirty A bitmap receiving the dirty bits, bit i % 64 of word i / 64 corresponds to the i-th page (can be NULL)
+ * @param[in] flags A combination of PTEDIT_HARVEST_CLEAR_ACCESSED and PTEDIT_HARVEST_CLEAR_DIRTY, or 0 to keep the bits
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_harvest_accessed_dirty(pid_t pid, void* start, void* end, size_t* accessed, size_t* dirty, int flags);
+
+/**
+ * Watches a virtual address range of a given process for changes of its page tables (e.g., unmapping, migration, or copy on write).
+ * Changes are reported as events which are retrieved using ptedit_read_events. Only one range can be watched at a time, watching a new range replaces the previous one.
+ * Requires Linux 5.0 or newer with CONFIG_MMU_NOTIFIER.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] start The start of the range
+ * @param[in] end The end of the range (exclusive)
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_watch(pid_t pid, void* start, void* end);
+
+/**
+ * Stops watching the range registered with ptedit_watch.
+ *
+ */
+ptedit_fnc void ptedit_unwatch();
+
+/**
+ * Retrieves change events of the watched range. Each event is one of PTEDIT_EVENT_INVALIDATE (the entries of the given range changed),
+ * PTEDIT_EVENT_RELEASE (the process exited), or PTEDIT_EVENT_OVERFLOW (events were lost, the entire range has to be considered changed).
+ *
+ * @param[out] events A buffer for the events
+ * @param[in] count The number of events the buffer can hold
+ * @param[in] wait Wait for an event if none is available
+ *
+ * @return The number of events written to the buffer
+ */
+ptedit_fnc size_t ptedit_read_events(ptedit_event_t* events, size_t count, int wait);
+
+/**
+ * Handle of a process attached with ptedit_attach or ptedit_attach_pidfd
+ */
+typedef struct {
+    /** Session of the kernel module which is attached to the process */
+    int fd;
+    /** Process id of the attached process */
+    pid_t pid;
+} ptedit_target_t;
+
+/**
+ * Attaches to a process. The kernel module pins the address space of the process, thus the process is not looked up again for every request and the address space stays valid until the target is detached, even if the process exits.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[out] target The handle of the attached process
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_attach(pid_t pid, ptedit_target_t* target);
+
+/**
+ * Attaches to a process referred to by a pidfd (see pidfd_open). In contrast to a pid, a pidfd cannot refer to a different process if the pid is reused.
+ * Requires Linux 5.3 or newer.
+ *
+ * @param[in] pidfd The pidfd of the process
+ * @param[out] target The handle of the attached process
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_attach_pidfd(int pidfd, ptedit_target_t* target);
+
+/**
+ * Detaches from a process and releases the handle.
+ *
+ * @param[in] target The handle of the attached process
+ */
+ptedit_fnc void ptedit_detach(ptedit_target_t* target);
+
+/**
+ * Resolves the page-table entries of all levels for a virtual address of an attached process.
+ *
+ * @param[in] target The handle of the attached process
+ * @param[in] address The virtual address to resolve
+ *
+ * @return A structure containing the page-table entries of all levels.
+ */
+ptedit_fnc ptedit_entry_t ptedit_target_resolve(ptedit_target_t* target, void* address);
+
+/**
+ * Updates one or more page-table entries for a virtual address of an attached process.
+ * The TLB for the given address is flushed after updating the entries.
+ *
+ * @param[in] target The handle of the attached process
+ * @param[in] address The virtual address
+ * @param[in] vm A structure containing the values for the page-table entries and a bitmask indicating which entries to update
+ */
+ptedit_fnc void ptedit_target_update(ptedit_target_t* target, void* address, ptedit_entry_t* vm);
+
+/**
+ * Returns the root of the paging structure (i.e., CR3 on x86 and TTBR0 on ARM) of an attached process.
+ *
+ * @param[in] target The handle of the attached process
+ *
+ * @return The phyiscal address (not PFN!) of the first page table (i.e., the PGD)
+ */
+ptedit_fnc size_t ptedit_target_get_paging_root(ptedit_target_t* target);
+
 /**
  * Sets a bit directly in the PTE of an address.
  *
@@ -277,6 +612,38 @@ ptedit_fnc void ptedit_set_bit(void* address, pid_t pid, int bit,size_t paging_a
  */
 ptedit_fnc void ptedit_clear_bit(void* address, pid_t pid, int bit,size_t paging_affected_levels);
 
+/**
+ * Sets a bit in all present leaf entries of a virtual address range of a given process.
+ * The page tables are walked once by the kernel, and the TLB is flushed once for the modified range afterwards.
+ * Huge pages which are only partially in the range are modified entirely, hugetlbfs mappings are skipped.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] start The start of the range
+ * @param[in] end The end of the range (exclusive)
+ * @param[in] bit The bit to set (one of PTEDIT_PAGE_BIT_*)
+ * @param[in] paging_affected_levels Levels of the leaf entries to modify, combination of PTEDIT_VALID_MASK_PTE, PTEDIT_VALID_MASK_PMD, and PTEDIT_VALID_MASK_PUD
+ *
+ * @return 0 Bits were set
+ * @return -1 Setting the bits failed
+ */
+ptedit_fnc int ptedit_set_bit_range(pid_t pid, void* start, void* end, int bit, size_t paging_affected_levels);
+
+/**
+ * Clears a bit in all present leaf entries of a virtual address range of a given process.
+ * The page tables are walked once by the kernel, and the TLB is flushed once for the modified range afterwards.
+ * Huge pages which are only partially in the range are modified entirely, hugetlbfs mappings are skipped.
+ *
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] start The start of the range
+ * @param[in] end The end of the range (exclusive)
+ * @param[in] bit The bit to clear (one of PTEDIT_PAGE_BIT_*)
+ * @param[in] paging_affected_levels Levels of the leaf entries to modify, combination of PTEDIT_VALID_MASK_PTE, PTEDIT_VALID_MASK_PMD, and PTEDIT_VALID_MASK_PUD
+ *
+ * @return 0 Bits were cleared
+ * @return -1 Clearing the bits failed
+ */
+ptedit_fnc int ptedit_clear_bit_range(pid_t pid, void* start, void* end, int bit, size_t paging_affected_levels);
+
 /**
  * Returns the value of a bit directly from the PTE of an address.
  *
@@ -502,6 +869,59 @@ typedef struct {
     size_t ingored_1 : 4;
     size_t ignored_2 : 5;
 }__attribute__((__packed__)) ptedit_pte_t;
+
+#elif defined(__riscv)
+#define PTEDIT_PAGE_PRESENT 1
+
+
+/**
+ * Struct to access the fields of the PGD (Sv39, Sv48, and Sv57 share the entry format on all levels)
+ */
+typedef struct {
+    size_t present : 1;
+    size_t readable : 1;
+    size_t writeable : 1;
+    size_t executable : 1;
+    size_t user_access : 1;
+    size_t global : 1;
+    size_t accessed : 1;
+    size_t dirty : 1;
+    size_t ignored_1 : 2;
+    size_t pfn : 44;
+    size_t reserved_1 : 7;
+    size_t memory_type : 2;
+    size_t napot : 1;
+}__attribute__((__packed__)) ptedit_pgd_t;
+
+
+/**
+ * Struct to access the fields of the P4D
+ */
+typedef ptedit_pgd_t ptedit_p4d_t;
+
+
+/**
+ * Struct to access the fields of the PUD
+ */
+typedef ptedit_pgd_t ptedit_pud_t;
+
+
+/**
+ * Struct to access the fields of the PMD
+ */
+typedef ptedit_pgd_t ptedit_pmd_t;
+
+
+/**
+ * Struct to access the fields of the PMD when mapping a large page (2MB)
+ */
+typedef ptedit_pgd_t ptedit_pmd_large_t;
+
+
+/**
+ * Struct to access the fields of the PTE
+ */
+typedef ptedit_pgd_t ptedit_pte_t;
 #endif
 
 /**
@@ -533,6 +953,24 @@ typedef struct {
    */
 ptedit_fnc int ptedit_get_pagesize();
 
+  /**
+   * Returns the number of page-table levels used by the system, e.g., 5 on x86 with 5-level paging (LA57)
+   *
+   * @return Number of page-table levels, -1 on failure
+   */
+ptedit_fnc int ptedit_get_paging_levels();
+
+  /**
+   * Retrieves the statistics of the kernel module, i.e., the number of calls and a log2 latency histogram per command,
+   * the time spent waiting for the mmap lock, and the number and latency of TLB invalidations.
+   * The statistics can also be read and reset via debugfs (pteditor/stats and pteditor/reset).
+   *
+   * @param[out] stats The structure receiving the statistics
+   *
+   * @return 0 on success, -1 on failure
+   */
+ptedit_fnc int ptedit_get_stats(ptedit_stats_t* stats);
+
 /** @} */
 
 
@@ -595,6 +1033,28 @@ ptedit_fnc void ptedit_read_physical_page(size_t pfn, char* buffer);
  */
 ptedit_fnc void ptedit_write_physical_page(size_t pfn, char* content);
 
+/**
+ * Retrieves the content of multiple physical memory ranges.
+ * On Linux, all ranges are copied with a single request to the kernel.
+ *
+ * @param[in,out] pages The ranges to read, each given by its first page-frame number (pfn), its length in bytes (size, 0 for one page), and the destination buffer (buffer)
+ * @param[in] count The number of ranges
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_read_physical_pages(ptedit_page_t* pages, size_t count);
+
+/**
+ * Replaces the content of multiple physical memory ranges.
+ * On Linux, all ranges are copied with a single request to the kernel.
+ *
+ * @param[in] pages The ranges to write, each given by its first page-frame number (pfn), its length in bytes (size, 0 for one page), and the new content (buffer)
+ * @param[in] count The number of ranges
+ *
+ * @return 0 on success, -1 on failure
+ */
+ptedit_fnc int ptedit_write_physical_pages(ptedit_page_t* pages, size_t count);
+
 /**
  * Map a physical address range.
  *
@@ -656,10 +1116,26 @@ ptedit_fnc void ptedit_set_paging_root(pid_t pid, size_t root);
   */
 ptedit_fnc void ptedit_invalidate_tlb(void* address);
 
+ /**
+  * Invalidates the TLB for a range of addresses of a given process on all CPUs.
+  * On Linux, the range is invalidated with a single request to the kernel. If the range is larger than the flush ceiling of the 
+  * kernel module (module parameter tlb_flush_ceiling), the entire TLB is flushed instead.
+  *
+  * @param[in] pid The pid of the process (0 for own process)
+  * @param[in] start The start of the range
+  * @param[in] end The end of the range (exclusive)
+  *
+  */
+ptedit_fnc void ptedit_invalidate_tlb_range(pid_t pid, void* start, void* end);
+
  /**
   * Change the method used for flushing the TLB (either kernel or custom function)
+  * The PCID-aware custom function only flushes the PCIDs the kernel assigned to the process, instead of all 4096 PCIDs.
+  * The process is only known to updates and ptedit_invalidate_tlb_range, ptedit_invalidate_tlb still flushes all PCIDs.
+  * The cpumask custom function additionally only interrupts the CPUs the process is currently active on.
+  * On RISC-V, the custom functions send SBI remote fences (sfence.vma) restricted to the address and ASID of the process.
   *
-  * @param[in] implementation The implementation to use, either PTEDITOR_TLB_INVALIDATION_KERNEL or PTEDITOR_TLB_INVALIDATION_CUSTOM
+  * @param[in] implementation The implementation to use, either PTEDITOR_TLB_INVALIDATION_KERNEL, PTEDITOR_TLB_INVALIDATION_CUSTOM, PTEDITOR_TLB_INVALIDATION_CUSTOM_PCID, or PTEDITOR_TLB_INVALIDATION_CUSTOM_CPUMASK
   *
   * @return 0 on success, -1 on failure
   */
@@ -674,6 +1150,107 @@ ptedit_fnc void ptedit_full_serializing_barrier();
 /** @} */
 
 
+/**
+ * Asynchronous operations using io_uring (Linux 5.19 or newer)
+ *
+ * Commands are queued in a submission queue, executed by the kernel in the background, and reported in a completion queue.
+ * All structures passed to a command must stay valid until its completion is reaped.
+ *
+ * @defgroup ASYNC Asynchronous operations
+ *
+ * @{
+ */
+
+/**
+ * Sets up the io_uring instance used for asynchronous operations. Requires an initialized PTEditor (ptedit_init).
+ *
+ * @param[in] entries The number of commands which can be queued before they have to be submitted
+ *
+ * @return 0 on success, -1 on failure (e.g., io_uring not supported)
+ */
+ptedit_fnc int ptedit_async_init(unsigned int entries);
+
+/**
+ * Tears down the io_uring instance. Called by ptedit_cleanup.
+ *
+ */
+ptedit_fnc void ptedit_async_cleanup();
+
+/**
+ * Queues the resolution of the page-table entries of a virtual address.
+ *
+ * @param[in] address The virtual address to resolve
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[out] entry The structure receiving the page-table entries on completion
+ * @param[in] user_data A value which identifies the command on completion
+ *
+ * @return 0 on success, -1 if the command could not be queued
+ */
+ptedit_fnc int ptedit_async_resolve(void* address, pid_t pid, ptedit_entry_t* entry, size_t user_data);
+
+/**
+ * Queues an update of page-table entries of a virtual address. The TLB for the address is flushed after the update.
+ *
+ * @param[in] address The virtual address
+ * @param[in] pid The pid of the process (0 for own process)
+ * @param[in] vm A structure containing the values for the page-table entries and a bitmask indicating which entries to update
+ * @param[in] user_data A value which identifies the command on completion
+ *
+ * @return 0 on success, -1 if the command could not be queued
+ */
+ptedit_fnc int ptedit_async_update(void* address, pid_t pid, ptedit_entry_t* vm, size_t user_data);
+
+/**
+ * Queues a read of a physical page.
+ *
+ * @param[in] page The page-frame number (pfn) of the page and the buffer receiving its content (buffer)
+ * @param[in] user_data A value which identifies the command on completion
+ *
+ * @return 0 on success, -1 if the command could not be queued
+ */
+ptedit_fnc int ptedit_async_read_physical_page(ptedit_page_t* page, size_t user_data);
+
+/**
+ * Queues a write of a physical page.
+ *
+ * @param[in] page The page-frame number (pfn) of the page and a buffer containing its new content (buffer)
+ * @param[in] user_data A value which identifies the command on completion
+ *
+ * @return 0 on success, -1 if the command could not be queued
+ */
+ptedit_fnc int ptedit_async_write_physical_page(ptedit_page_t* page, size_t user_data);
+
+/**
+ * Queues an invalidation of the TLB for a given address on all CPUs.
+ *
+ * @param[in] address The address to invalidate
+ * @param[in] user_data A value which identifies the command on completion
+ *
+ * @return 0 on success, -1 if the command could not be queued
+ */
+ptedit_fnc int ptedit_async_invalidate_tlb(void* address, size_t user_data);
+
+/**
+ * Submits all queued commands to the kernel without waiting for their completion.
+ *
+ * @return The number of submitted commands, -1 on failure
+ */
+ptedit_fnc int ptedit_async_submit();
+
+/**
+ * Reaps the completion of one command. Queued commands are submitted if necessary.
+ *
+ * @param[out] user_data The user data of the completed command (can be NULL)
+ * @param[out] result The result of the command, negative error codes indicate failures (can be NULL)
+ * @param[in] wait Wait for a completion if none is available
+ *
+ * @return 1 if a completion was reaped, 0 if none is available, -1 on failure
+ */
+ptedit_fnc int ptedit_async_complete(size_t* user_data, int* result, int wait);
+
+/** @} */
+
+
 
 /**
  * Memory types (x86 PATs / ARM MAIR)
@@ -0,0 +1,137 @@
+#!/bin/sh
+# Cross-builds the kernel module and the tests for riscv64 and runs the tests in QEMU with Sv39, Sv48, and Sv57
+# Requires gcc-riscv64-linux-gnu, qemu-system-misc, opensbi, and the usual kernel build dependencies (flex, bison, bc, libssl-dev, libelf-dev)
+set -e
+
+KERNEL_VERSION=${KERNEL_VERSION:-6.6.58}
+CROSS_COMPILE=${CROSS_COMPILE:-riscv64-linux-gnu-}
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+WORK=${WORK:-$ROOT/test/riscv64}
+KDIR=$WORK/linux-$KERNEL_VERSION
+KMAKE="make -C $KDIR ARCH=riscv CROSS_COMPILE=$CROSS_COMPILE"
+
+mkdir -p "$WORK"
+cd "$WORK"
+
+# Kernel with everything the module relies on (kprobes for kallsyms_lookup_name, data symbols such as asid_mask, /dev/mem, THP)
+if [ ! -d "$KDIR" ]; then
+    wget -qO- https://cdn.kernel.org/pub/linux/kernel/v6.x/linux-$KERNEL_VERSION.tar.xz | tar xJ
+fi
+if [ ! -f "$KDIR/arch/riscv/boot/Image" ]; then
+    $KMAKE defconfig
+    "$KDIR/scripts/config" --file "$KDIR/.config" -e MODULES -e KPROBES -e KRETPROBES -e KALLSYMS -e KALLSYMS_ALL \
+        -e DEVMEM -d STRICT_DEVMEM -e DEBUG_FS -e TRANSPARENT_HUGEPAGE -e IO_URING -e BLK_DEV_INITRD -e DEVTMPFS
+    $KMAKE olddefconfig
+    $KMAKE -j"$(nproc)" Image modules
+fi
+
+# Module and tests (static, as the initramfs has no libc)
+$KMAKE M="$ROOT/module" modules
+${CROSS_COMPILE}gcc -Os "$ROOT/test/tests.c" -std=gnu99 -static -pthread -o tests
+
+# Minimal init: load the module, run the tests one by one, report the result, power off
+cat > init.c << 'EOF'
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mount.h>
+#include <sys/reboot.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Runs /tests with the given argument, the output goes to out (or the console if out is negative)
+static int run_tests(const char* arg, int out) {
+    int status = -1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        char* argv[] = {"/tests", (char*)arg, NULL};
+        if (out >= 0) dup2(out, STDOUT_FILENO);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int main() {
+    int status = -1, fd, pipefd[2], tests = 0, listed = -1;
+    char line[256], filter[300];
+    FILE* f;
+    mount("proc", "/proc", "proc", 0, NULL);
+    mount("sysfs", "/sys", "sysfs", 0, NULL);
+    mount("devtmpfs", "/dev", "devtmpfs", 0, NULL);
+    mount("debugfs", "/sys/kernel/debug", "debugfs", 0, NULL);
+    if ((f = fopen("/proc/cpuinfo", "r"))) {
+        while (fgets(line, sizeof(line), f)) {
+            if (!strncmp(line, "mmu", 3)) printf("%s", line);
+        }
+        fclose(f);
+    }
+    fd = open("/pteditor.ko", O_RDONLY);
+    if (fd < 0 || syscall(SYS_finit_module, fd, "", 0)) {
+        perror("finit_module");
+    } else if (!pipe(pipefd)) {
+        // QEMU does not model caches, skip the timing-based tests
+        status = 0;
+        pid_t lister = fork();
+        if (!lister) {
+            close(pipefd[0]);
+            _exit(run_tests("--list-tests", pipefd[1]));
+        }
+        close(pipefd[1]);
+        f = fdopen(pipefd[0], "r");
+        while (fgets(line, sizeof(line), f)) {
+            line[strcspn(line, "\r\n")] = 0;
+            // Test names are "set.name", skip anything else the library prints
+            if (!strchr(line, '.') || strchr(line, ' ') || strstr(line, "access_time")) continue;
+            snprintf(filter, sizeof(filter), "--filter=%s", line);
+            fflush(stdout);
+            if (run_tests(filter, -1)) status = 1;
+            tests++;
+        }
+        fclose(f);
+        waitpid(lister, &listed, 0);
+        if (!tests || !WIFEXITED(listed) || WEXITSTATUS(listed)) status = 1;
+    }
+    printf("PTEDITOR-TESTS-EXIT %d\n", status);
+    fflush(stdout);
+    sync();
+    reboot(RB_POWER_OFF);
+    return 0;
+}
+EOF
+${CROSS_COMPILE}gcc -Os init.c -static -o init
+
+cat > initramfs.list << EOF
+dir /dev 0755 0 0
+nod /dev/console 0600 0 0 c 5 1
+dir /proc 0755 0 0
+dir /sys 0755 0 0
+file /init $WORK/init 0755 0 0
+file /tests $WORK/tests 0755 0 0
+file /pteditor.ko $ROOT/module/pteditor.ko 0644 0 0
+EOF
+"$KDIR/usr/gen_init_cpio" initramfs.list > initramfs.cpio
+
+# The guest kernel selects the paging mode, no4lvl forces Sv39 and no5lvl forces Sv48
+# Two harts, as the TLB tests remap memory used by a process pinned to another hart
+FAILED=0
+for MODE in sv39 sv48 sv57; do
+    case $MODE in
+        sv39) APPEND=no4lvl ;;
+        sv48) APPEND=no5lvl ;;
+        *) APPEND= ;;
+    esac
+    timeout 3600 qemu-system-riscv64 -machine virt -cpu rv64,sv57=on,svpbmt=on -smp 2 -m 2G -nographic -no-reboot \
+        -bios default -kernel "$KDIR/arch/riscv/boot/Image" -initrd initramfs.cpio \
+        -append "console=ttyS0 panic=-1 $APPEND" | tee "$MODE.log"
+    if grep -q "^mmu.*: $MODE" "$MODE.log" && grep -q "PTEDITOR-TESTS-EXIT 0" "$MODE.log"; then
+        echo "$MODE: passed"
+    else
+        echo "$MODE: FAILED"
+        FAILED=1
+    fi
+done
+exit $FAILED
@@ -1,7 +1,13 @@
+#define _GNU_SOURCE
 #include "utest.h"
 #include "../ptedit_header.h"
 #include <time.h>
 #include <stdlib.h>
+#include <errno.h>
+#if defined(LINUX)
+#include <sched.h>
+#include <sys/wait.h>
+#endif
 
 UTEST_STATE();
 
@@ -19,6 +25,12 @@ void flush(void *p) {
   asm volatile("DSB ISH");
   asm volatile("ISB");
 }
+#elif defined(__riscv)
+/* There is no architectural cache flush for user space, only order the accesses */
+void flush(void *p) {
+  (void)p;
+  asm volatile("fence rw, rw" ::: "memory");
+}
 #endif
 
 #ifndef MAP_HUGE_2MB
@@ -150,6 +162,147 @@ UTEST(resolve, resolve_page_offset) {
     ASSERT_TRUE(entry_equal(&vm1, &vm4));
 }
 
+UTEST(resolve, resolve_batch) {
+    ptedit_entry_t entries[4];
+    void* addresses[4] = {page1, page2, scratch, 0};
+    for(int i = 0; i < 4; i++) {
+        memset(&entries[i], 0, sizeof(entries[i]));
+        entries[i].vaddr = (size_t)addresses[i];
+    }
+    ptedit_resolve_batch(entries, 4, 0);
+    for(int i = 0; i < 3; i++) {
+        ptedit_entry_t vm = ptedit_resolve(addresses[i], 0);
+        ASSERT_EQ(entries[i].vaddr, (size_t)addresses[i]);
+        ASSERT_EQ(entries[i].valid, vm.valid);
+        ASSERT_TRUE(entry_equal(&entries[i], &vm));
+    }
+    ASSERT_FALSE(entries[3].valid & PTEDIT_VALID_MASK_PTE);
+}
+
+UTEST(resolve, resolve_leaf_level) {
+    ptedit_entry_t vm = ptedit_resolve(page1, 0);
+    ASSERT_EQ(vm.level, (size_t)PTEDIT_VALID_MASK_PTE);
+    ASSERT_EQ(vm.page_size, (size_t)4096);
+}
+
+UTEST(resolve, resolve_huge_page) {
+    size_t huge = 2 * 1024 * 1024;
+    char* mapping = mmap(0, 2 * huge, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+    char* aligned = (char*)(((size_t)mapping + huge - 1) & ~(huge - 1));
+    madvise(aligned, huge, MADV_HUGEPAGE);
+    memset(aligned, 1, huge);
+    ptedit_entry_t vm = ptedit_resolve(aligned + huge / 2, 0);
+    /* Transparent huge pages are not guaranteed, but a huge page has to be reported as PMD leaf */
+    if(vm.level == PTEDIT_VALID_MASK_PMD) {
+        ASSERT_EQ(vm.page_size, huge);
+        ASSERT_FALSE(vm.valid & PTEDIT_VALID_MASK_PTE);
+        ptedit_entry_t vm2 = ptedit_resolve(aligned, 0);
+        ASSERT_EQ(vm2.pmd, vm.pmd);
+    } else {
+        ASSERT_EQ(vm.level, (size_t)PTEDIT_VALID_MASK_PTE);
+        ASSERT_EQ(vm.page_size, (size_t)4096);
+    }
+    munmap(mapping, 2 * huge);
+}
+
+UTEST(resolve, resolve_batch_invalid_pid) {
+    ptedit_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.vaddr = (size_t)page1;
+    ptedit_resolve_batch(&entry, 1, -1);
+    ASSERT_FALSE(entry.valid);
+}
+
+UTEST(resolve, filter_table) {
+    size_t entries[512], indices[512], i, expected = 0;
+    unsigned char bitmap[512 / 8];
+    ptedit_filter_t filter;
+    for (i = 0; i < 512; i++) {
+        entries[i] = ptedit_set_pfn((i % 3) ? (1ull << PTEDIT_PAGE_BIT_PRESENT) : 0, i);
+        if ((i % 3) && i >= 100 && i <= 299) expected++;
+    }
+    filter.mask = 1ull << PTEDIT_PAGE_BIT_PRESENT;
+    filter.value = 1ull << PTEDIT_PAGE_BIT_PRESENT;
+    filter.pfn_min = 100;
+    filter.pfn_max = 299;
+    ASSERT_EQ(ptedit_filter_table(entries, 512, &filter, bitmap, indices), expected);
+    for (i = 0; i < expected; i++) {
+        ASSERT_TRUE(indices[i] % 3);
+        ASSERT_GE(indices[i], 100);
+        ASSERT_LE(indices[i], 299);
+        ASSERT_TRUE(bitmap[indices[i] / 8] & (1 << (indices[i] % 8)));
+    }
+    filter.pfn_min = 0;
+    filter.pfn_max = (size_t)-1;
+    ASSERT_EQ(ptedit_filter_table(entries, 500, &filter, NULL, NULL), 333);
+}
+
+UTEST(resolve, dump_range) {
+    ptedit_leaf_t leaves[4];
+    size_t start = (size_t)page1, end = (size_t)page1 + sizeof(page1);
+    size_t count = ptedit_dump_range(0, &start, end, leaves, 4);
+    ASSERT_EQ(count, 1);
+    ASSERT_GE(start, end);
+    ptedit_entry_t vm = ptedit_resolve(page1, 0);
+    ASSERT_EQ(leaves[0].vaddr, (size_t)page1);
+    ASSERT_EQ(leaves[0].level, PTEDIT_VALID_MASK_PTE);
+    ASSERT_EQ(ptedit_get_pfn(leaves[0].entry), ptedit_get_pfn(vm.pte));
+}
+
+static int count_leaves(ptedit_leaf_t* leaf, void* ctx) {
+    size_t* count = (size_t*)ctx;
+    if (leaf->level == PTEDIT_VALID_MASK_PTE && leaf->size == 4096 && ptedit_pte_get_pfn((void*)leaf->vaddr, 0) == ptedit_get_pfn(leaf->entry)) {
+        (*count)++;
+    }
+    return 0;
+}
+
+static int stop_walk(ptedit_leaf_t* leaf, void* ctx) {
+    (void)leaf;
+    (*(size_t*)ctx)++;
+    return 1;
+}
+
+UTEST(resolve, walk_range) {
+    size_t count = 0;
+    char* mapping = mmap(0, 4 * 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+    ASSERT_FALSE(ptedit_walk_range(0, mapping, mapping + 4 * 4096, 0, count_leaves, &count));
+    ASSERT_EQ(count, 4);
+    count = 0;
+    ASSERT_FALSE(ptedit_walk_range(0, mapping, mapping + 4 * 4096, 0, stop_walk, &count));
+    ASSERT_EQ(count, 1);
+    munmap(mapping, 4 * 4096);
+}
+
+UTEST(resolve, walk_range_parallel) {
+    size_t counts[4] = { 0 };
+    void* ctx[4] = { &counts[0], &counts[1], &counts[2], &counts[3] };
+    char* mapping = mmap(0, 64 * 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+    ASSERT_FALSE(ptedit_walk_range_parallel(0, mapping, mapping + 64 * 4096, 0, count_leaves, ctx, 4));
+    ASSERT_EQ(counts[0] + counts[1] + counts[2] + counts[3], 64);
+    munmap(mapping, 64 * 4096);
+}
+
+UTEST(resolve, dump_range_cursor) {
+    size_t pages = 16, found = 0, calls = 0;
+    char* mapping = mmap(0, pages * 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+    ptedit_leaf_t leaves[3];
+    size_t start = (size_t)mapping, end = (size_t)mapping + pages * 4096;
+    while (start < end && calls++ < pages) {
+        size_t count = ptedit_dump_range(0, &start, end, leaves, 3);
+        for (size_t i = 0; i < count; i++) {
+            ASSERT_EQ(leaves[i].vaddr, (size_t)mapping + found * 4096);
+            found++;
+        }
+    }
+    munmap(mapping, pages * 4096);
+    ASSERT_EQ(found, pages);
+}
+
 
 // =========================================================================
 //                             Updating addresses
@@ -198,6 +351,124 @@ UTEST(update, new_pte) {
     ASSERT_TRUE(entry_equal(&vm, &vm2));
 }
 
+UTEST(update, batch) {
+    ASSERT_TRUE(accessor[0] == 2);
+    ptedit_entry_t entries[2];
+    entries[0] = ptedit_resolve(accessor, 0);
+    entries[1] = ptedit_resolve(scratch, 0);
+    ASSERT_TRUE(entries[0].valid & PTEDIT_VALID_MASK_PTE);
+    ASSERT_TRUE(entries[1].valid & PTEDIT_VALID_MASK_PTE);
+    size_t accessor_pte = entries[0].pte;
+    entries[0].pte = ptedit_set_pfn(entries[0].pte, ptedit_pte_get_pfn(page2, 0));
+    entries[0].valid = PTEDIT_VALID_MASK_PTE;
+    entries[1].valid = PTEDIT_VALID_MASK_PTE;
+    ptedit_update_batch(entries, 2, 0);
+    ASSERT_TRUE(accessor[0] == 1);
+    
+    entries[0].pte = accessor_pte;
+    ptedit_update_batch(entries, 1, 0);
+    ASSERT_TRUE(accessor[0] == 2);
+    ptedit_entry_t check = ptedit_resolve(accessor, 0);
+    ASSERT_EQ(ptedit_get_pfn(check.pte), ptedit_get_pfn(accessor_pte));
+}
+
+UTEST(update, locations) {
+    ptedit_location_t location;
+    size_t buffer[4096 / sizeof(size_t)];
+    ASSERT_TRUE(accessor[0] == 2);
+    ptedit_entry_t vm = ptedit_resolve_locations(accessor, 0, &location);
+    ASSERT_TRUE(location.valid & PTEDIT_VALID_MASK_PTE);
+    ptedit_read_physical_page(location.pte / 4096, (char*)buffer);
+    ASSERT_EQ(buffer[(location.pte % 4096) / sizeof(size_t)], vm.pte);
+
+    size_t pte = vm.pte;
+    vm.pte = ptedit_set_pfn(vm.pte, ptedit_pte_get_pfn(page2, 0));
+    vm.valid = PTEDIT_VALID_MASK_PTE;
+    ptedit_update_locations(accessor, 0, &vm, &location);
+    ASSERT_TRUE(accessor[0] == 1);
+    vm.pte = pte;
+    ptedit_update_locations(accessor, 0, &vm, &location);
+    ASSERT_TRUE(accessor[0] == 2);
+}
+
+UTEST(update, harvest_accessed_dirty) {
+    size_t accessed = 0, dirty = 0;
+    char* mapping = mmap(0, 4 * 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+    ASSERT_FALSE(ptedit_harvest_accessed_dirty(0, mapping, mapping + 4 * 4096, &accessed, &dirty, PTEDIT_HARVEST_CLEAR_ACCESSED | PTEDIT_HARVEST_CLEAR_DIRTY));
+    ASSERT_EQ(accessed, 0xf);
+    ASSERT_EQ(dirty, 0xf);
+    *(volatile char*)(mapping + 4096);
+    mapping[2 * 4096] = 1;
+    ASSERT_FALSE(ptedit_harvest_accessed_dirty(0, mapping, mapping + 4 * 4096, &accessed, &dirty, 0));
+    ASSERT_EQ(accessed, 0x6);
+    ASSERT_EQ(dirty, 0x4);
+    munmap(mapping, 4 * 4096);
+}
+
+UTEST(update, harvest_bitmap_words) {
+    size_t accessed[2] = {0, 0};
+    char* mapping = mmap(0, 70 * 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+    ASSERT_FALSE(ptedit_harvest_accessed_dirty(0, mapping, mapping + 70 * 4096, accessed, NULL, PTEDIT_HARVEST_CLEAR_ACCESSED));
+    ASSERT_EQ(accessed[1], (1ull << 6) - 1);
+    *(volatile char*)(mapping + 3 * 4096);
+    *(volatile char*)(mapping + 65 * 4096);
+    ASSERT_FALSE(ptedit_harvest_accessed_dirty(0, mapping, mapping + 70 * 4096, accessed, NULL, 0));
+    ASSERT_EQ(accessed[0], 1ull << 3);
+    ASSERT_EQ(accessed[1], 1ull << (65 % 64));
+    munmap(mapping, 70 * 4096);
+}
+
+UTEST(update, attach) {
+    ptedit_target_t target;
+    ASSERT_FALSE(ptedit_attach(0, &target));
+    ASSERT_EQ(target.pid, getpid());
+    ptedit_entry_t vm1 = ptedit_target_resolve(&target, page1);
+    ptedit_entry_t vm2 = ptedit_resolve_kernel(page1, 0);
+    ASSERT_TRUE(vm1.valid & PTEDIT_VALID_MASK_PTE);
+    ASSERT_EQ(vm1.pte, vm2.pte);
+    ASSERT_EQ(ptedit_target_get_paging_root(&target), ptedit_get_paging_root(0));
+    ptedit_detach(&target);
+    ASSERT_EQ(target.fd, -1);
+}
+
+UTEST(update, attach_pidfd) {
+#if defined(SYS_pidfd_open)
+    ptedit_target_t target;
+    int pidfd = (int)syscall(SYS_pidfd_open, getpid(), 0);
+    if(pidfd < 0) return;
+    ASSERT_FALSE(ptedit_attach_pidfd(pidfd, &target));
+    ASSERT_EQ(target.pid, getpid());
+    ptedit_entry_t vm1 = ptedit_target_resolve(&target, page2);
+    ptedit_entry_t vm2 = ptedit_resolve_kernel(page2, 0);
+    ASSERT_EQ(vm1.pte, vm2.pte);
+    ptedit_detach(&target);
+    close(pidfd);
+#endif
+}
+
+UTEST(update, watch) {
+    ptedit_event_t events[8];
+    size_t count, i, found = 0;
+    char* mapping = mmap(0, 4 * 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+    ASSERT_FALSE(ptedit_watch(0, mapping, mapping + 4 * 4096));
+    ASSERT_EQ(ptedit_read_events(events, 8, 0), 0);
+    madvise(mapping + 4096, 4096, MADV_DONTNEED);
+    count = ptedit_read_events(events, 8, 0);
+    for (i = 0; i < count; i++) {
+        if (events[i].event == PTEDIT_EVENT_INVALIDATE && events[i].start <= (size_t)mapping + 4096 && events[i].end >= (size_t)mapping + 2 * 4096) {
+            found = 1;
+        }
+        ASSERT_GE(events[i].start, (size_t)mapping);
+        ASSERT_LE(events[i].end, (size_t)mapping + 4 * 4096);
+    }
+    ASSERT_TRUE(found);
+    ptedit_unwatch();
+    munmap(mapping, 4 * 4096);
+}
+
 // =========================================================================
 //                                  PTEs
 // =========================================================================
@@ -273,6 +544,21 @@ UTEST(pte, ptedit_set_bit) {
     ASSERT_TRUE(PTEDIT_B(entry.pd, PTEDIT_PAGE_BIT_ACCESSED) == 1);
 }
 
+UTEST(pte, bit_range) {
+    int i;
+    char* mapping = mmap(0, 16 * 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+    ASSERT_FALSE(ptedit_clear_bit_range(0, mapping, mapping + 16 * 4096, PTEDIT_PAGE_BIT_ACCESSED, PTEDIT_VALID_MASK_PTE | PTEDIT_VALID_MASK_PMD));
+    for (i = 0; i < 16; i++) {
+        ASSERT_FALSE(ptedit_pte_get_bit(mapping + i * 4096, 0, PTEDIT_PAGE_BIT_ACCESSED));
+    }
+    ASSERT_FALSE(ptedit_set_bit_range(0, mapping, mapping + 16 * 4096, PTEDIT_PAGE_BIT_ACCESSED, PTEDIT_VALID_MASK_PTE | PTEDIT_VALID_MASK_PMD));
+    for (i = 0; i < 16; i++) {
+        ASSERT_TRUE(ptedit_pte_get_bit(mapping + i * 4096, 0, PTEDIT_PAGE_BIT_ACCESSED));
+    }
+    munmap(mapping, 16 * 4096);
+}
+
 // =========================================================================
 //                             Physical Pages
 // =========================================================================
@@ -301,6 +587,134 @@ UTEST(page, write) {
     ASSERT_TRUE(!memcmp(page2, buffer, sizeof(buffer)));
 }
 
+UTEST(page, read_pages) {
+    char buffer[2][4096];
+    ptedit_page_t pages[2];
+    memset(pages, 0, sizeof(pages));
+    pages[0].pfn = ptedit_pte_get_pfn(page1, 0);
+    pages[0].buffer = (unsigned char*)buffer[0];
+    pages[1].pfn = ptedit_pte_get_pfn(page2, 0);
+    pages[1].buffer = (unsigned char*)buffer[1];
+    ASSERT_TRUE(pages[0].pfn);
+    ASSERT_TRUE(pages[1].pfn);
+    ASSERT_FALSE(ptedit_read_physical_pages(pages, 2));
+    ASSERT_TRUE(!memcmp(buffer[0], page1, 4096));
+    ASSERT_TRUE(!memcmp(buffer[1], page2, 4096));
+}
+
+UTEST(page, write_pages) {
+    char buffer[4096];
+    ptedit_page_t page;
+    memset(&page, 0, sizeof(page));
+    page.pfn = ptedit_pte_get_pfn(scratch, 0);
+    ASSERT_TRUE(page.pfn);
+    page.size = 4096;
+    page.buffer = (unsigned char*)page2;
+    ASSERT_FALSE(ptedit_write_physical_pages(&page, 1));
+    ptedit_read_physical_page(page.pfn, buffer);
+    ASSERT_TRUE(!memcmp(page2, buffer, sizeof(buffer)));
+}
+
+UTEST(page, write_read_pages_partial) {
+    char buffer[2][64];
+    ptedit_page_t pages[2];
+    memset(pages, 0, sizeof(pages));
+    pages[0].pfn = ptedit_pte_get_pfn(scratch, 0);
+    pages[0].size = sizeof(buffer[0]);
+    pages[0].buffer = (unsigned char*)page1;
+    pages[1].pfn = pages[0].pfn;
+    pages[1].size = sizeof(buffer[1]) / 2;
+    pages[1].buffer = (unsigned char*)page2;
+    ASSERT_TRUE(pages[0].pfn);
+    /* Tuples are applied in order, the second one overwrites the start of the first */
+    ASSERT_FALSE(ptedit_write_physical_pages(pages, 2));
+    pages[0].buffer = (unsigned char*)buffer[0];
+    pages[1].size = sizeof(buffer[1]);
+    pages[1].buffer = (unsigned char*)buffer[1];
+    ASSERT_FALSE(ptedit_read_physical_pages(pages, 2));
+    ASSERT_TRUE(!memcmp(buffer[0], page2, sizeof(buffer[0]) / 2));
+    ASSERT_TRUE(!memcmp(buffer[0] + sizeof(buffer[0]) / 2, page1 + sizeof(buffer[0]) / 2, sizeof(buffer[0]) / 2));
+    ASSERT_TRUE(!memcmp(buffer[0], buffer[1], sizeof(buffer[0])));
+}
+
+UTEST(page, read_pages_invalid_pfn) {
+    char buffer[64];
+    ptedit_page_t page;
+    memset(&page, 0, sizeof(page));
+    /* Not backed by the direct mapping, rejected by the kernel */
+    page.pfn = ((size_t)-1) >> 16;
+    page.size = sizeof(buffer);
+    page.buffer = (unsigned char*)buffer;
+    ASSERT_TRUE(ptedit_read_physical_pages(&page, 1));
+}
+
+// =========================================================================
+//                                Stats
+// =========================================================================
+
+#if defined(LINUX)
+UTEST(stats, resolve_counted) {
+    ptedit_stats_t before, after;
+    ptedit_entry_t vm;
+    size_t i, buckets = 0;
+    ptedit_use_implementation(PTEDIT_IMPL_KERNEL);
+    ASSERT_FALSE(ptedit_get_stats(&before));
+    vm = ptedit_resolve(scratch, 0);
+    ptedit_update(scratch, 0, &vm);
+    ASSERT_FALSE(ptedit_get_stats(&after));
+    ASSERT_GT(after.commands[PTEDIT_STATS_INDEX(PTEDITOR_IOCTL_CMD_VM_RESOLVE)].count, before.commands[PTEDIT_STATS_INDEX(PTEDITOR_IOCTL_CMD_VM_RESOLVE)].count);
+    ASSERT_GT(after.lock.count, before.lock.count);
+    ASSERT_GT(after.flush.count, before.flush.count);
+    for (i = 0; i < PTEDIT_STATS_BUCKETS; i++) {
+        buckets += after.flush.histogram[i] - before.flush.histogram[i];
+    }
+    ASSERT_TRUE(buckets);
+}
+#endif
+
+// =========================================================================
+//                                Async
+// =========================================================================
+
+#if defined(LINUX)
+UTEST(async, resolve_and_read) {
+    ptedit_entry_t entries[2];
+    ptedit_page_t page;
+    char buffer[4096];
+    size_t user_data, seen = 0;
+    int result, i;
+
+    if (ptedit_async_init(8)) {
+        /* io_uring not available */
+        return;
+    }
+    memset(&page, 0, sizeof(page));
+    page.pfn = ptedit_pte_get_pfn(page1, 0);
+    page.buffer = (unsigned char*)buffer;
+    ASSERT_FALSE(ptedit_async_resolve(page1, 0, &entries[0], 0));
+    ASSERT_FALSE(ptedit_async_resolve(page2, 0, &entries[1], 1));
+    ASSERT_FALSE(ptedit_async_read_physical_page(&page, 2));
+    ASSERT_FALSE(ptedit_async_invalidate_tlb(scratch, 3));
+    for (i = 0; i < 4; i++) {
+        ASSERT_EQ(ptedit_async_complete(&user_data, &result, 1), 1);
+        if (result == -EOPNOTSUPP) {
+            /* Kernel without io_uring commands */
+            ptedit_async_cleanup();
+            return;
+        }
+        ASSERT_EQ(result, 0);
+        ASSERT_LT(user_data, 4);
+        seen |= 1 << user_data;
+    }
+    ASSERT_EQ(seen, 15);
+    ASSERT_EQ(entries[0].pte, ptedit_resolve(page1, 0).pte);
+    ASSERT_EQ(entries[1].pte, ptedit_resolve(page2, 0).pte);
+    ASSERT_TRUE(!memcmp(buffer, page1, sizeof(buffer)));
+    ASSERT_EQ(ptedit_async_complete(&user_data, &result, 0), 0);
+    ptedit_async_cleanup();
+}
+#endif
+
 // =========================================================================
 //                                Paging
 // =========================================================================
@@ -328,6 +742,108 @@ UTEST(paging, root_page_aligned) {
     ASSERT_FALSE(root % ptedit_get_pagesize());
 }
 
+UTEST(paging, levels) {
+    int levels = ptedit_get_paging_levels();
+    ASSERT_GE(levels, 3);
+    ASSERT_LE(levels, 5);
+}
+
+UTEST(paging, user_resolve_levels) {
+    /* The user-space page walk requires /proc/umem */
+    if(ptedit_umem < 0) return;
+    ptedit_entry_t kernel = ptedit_resolve_kernel(page1, 0);
+    ptedit_use_implementation(PTEDIT_IMPL_USER_PREAD);
+    ptedit_entry_t user = ptedit_resolve(page1, 0);
+    ptedit_use_implementation(PTEDIT_IMPL_KERNEL);
+    ASSERT_EQ(user.pgd, kernel.pgd);
+    ASSERT_EQ(user.pte, kernel.pte);
+}
+
+UTEST(paging, user_resolve_pwc) {
+    /* The user-space page walk requires /proc/umem */
+    if(ptedit_umem < 0) return;
+    ptedit_entry_t kernel = ptedit_resolve_kernel(page1, 0);
+    ptedit_entry_t kernel2 = ptedit_resolve_kernel(page2, 0);
+    ptedit_use_implementation(PTEDIT_IMPL_USER_PREAD);
+    ptedit_pwc_enable(1);
+    ptedit_entry_t user = ptedit_resolve(page1, 0);
+    ptedit_entry_t cached = ptedit_resolve(page1, 0);
+    ptedit_entry_t user2 = ptedit_resolve(page2, 0);
+    ptedit_pwc_invalidate();
+    ptedit_entry_t uncached = ptedit_resolve(page1, 0);
+    ptedit_pwc_enable(0);
+    ptedit_use_implementation(PTEDIT_IMPL_KERNEL);
+    ASSERT_EQ(user.pmd, kernel.pmd);
+    ASSERT_EQ(user.pte, kernel.pte);
+    ASSERT_EQ(cached.valid, user.valid);
+    ASSERT_EQ(cached.pmd, kernel.pmd);
+    ASSERT_EQ(cached.pte, kernel.pte);
+    ASSERT_EQ(user2.pte, kernel2.pte);
+    ASSERT_EQ(uncached.pte, kernel.pte);
+}
+
+typedef struct {
+    char* address;
+    size_t pte;
+    int mismatches;
+} pwc_thread_t;
+
+void* pwc_resolve_thread(void* arg) {
+    pwc_thread_t* thread = (pwc_thread_t*)arg;
+    int i;
+    for (i = 0; i < 20000; i++) {
+        if (ptedit_resolve(thread->address, 0).pte != thread->pte) thread->mismatches++;
+    }
+    return NULL;
+}
+
+UTEST(paging, user_resolve_pwc_threads) {
+    /* The user-space page walk requires /proc/umem */
+    if(ptedit_umem < 0) return;
+    /* Addresses 128 MB apart share a cache slot (64 slots of 2 MB) but not their upper levels */
+    size_t stride = (size_t)PTEDIT_PWC_ENTRIES << 21;
+    char* mapping = mmap(0, 4 * stride, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+    pwc_thread_t threads[4];
+    pthread_t tids[4];
+    int i;
+    for (i = 0; i < 4; i++) {
+        threads[i].address = mapping + i * stride;
+        threads[i].address[0] = 1;
+        threads[i].pte = ptedit_resolve_kernel(threads[i].address, 0).pte;
+        threads[i].mismatches = 0;
+    }
+    ptedit_use_implementation(PTEDIT_IMPL_USER_PREAD);
+    ptedit_pwc_enable(1);
+    for (i = 0; i < 4; i++) pthread_create(&tids[i], NULL, pwc_resolve_thread, &threads[i]);
+    for (i = 0; i < 4; i++) pthread_join(tids[i], NULL);
+    ptedit_pwc_enable(0);
+    ptedit_use_implementation(PTEDIT_IMPL_KERNEL);
+    munmap(mapping, 4 * stride);
+    for (i = 0; i < 4; i++) ASSERT_EQ(threads[i].mismatches, 0);
+}
+
+UTEST(paging, user_locations_bypass_pwc) {
+    /* The user-space page walk requires /proc/umem */
+    if(ptedit_umem < 0) return;
+    ptedit_entry_t kernel = ptedit_resolve_kernel(page1, 0);
+    ptedit_location_t expected, location;
+    ptedit_locate_kernel(page1, 0, &kernel, &expected);
+    ptedit_use_implementation(PTEDIT_IMPL_USER_PREAD);
+    ptedit_pwc_enable(1);
+    ptedit_resolve(page1, 0);
+    /* Simulate a page table freed behind the back of the library */
+    size_t prefix = (size_t)page1 >> (ptedit_paging_definition.page_offset + ptedit_paging_definition.pt_entries);
+    ptedit_pwc[prefix % PTEDIT_PWC_ENTRIES].pmd = 0;
+    ptedit_entry_t stale = ptedit_resolve(page1, 0);
+    ptedit_entry_t vm = ptedit_resolve_locations(page1, 0, &location);
+    ptedit_pwc_enable(0);
+    ptedit_use_implementation(PTEDIT_IMPL_KERNEL);
+    ASSERT_EQ(stale.pmd, 0);
+    ASSERT_EQ(vm.pmd, kernel.pmd);
+    ASSERT_EQ(location.pte, expected.pte);
+}
+
 UTEST(paging, correct_root) {
     size_t buffer[4096 / sizeof(size_t)];
     size_t root = ptedit_get_paging_root(0);
@@ -454,12 +970,35 @@ UTEST(memtype, uncachable_huge_page_access_time) {
     }
 }
 
+// =========================================================================
+//                               Device
+// =========================================================================
+
+#if defined(LINUX)
+UTEST(device, multi_open) {
+    int fd = open(PTEDITOR_DEVICE_PATH, O_RDONLY);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ((int)ioctl(fd, PTEDITOR_IOCTL_CMD_GET_PAGESIZE, 0), ptedit_get_pagesize());
+    close(fd);
+}
+
+UTEST(device, per_client_tlb_invalidation) {
+    int fd = open(PTEDITOR_DEVICE_PATH, O_RDONLY);
+    ASSERT_GE(fd, 0);
+    ASSERT_FALSE(ioctl(fd, PTEDITOR_IOCTL_CMD_SWITCH_TLB_INVALIDATION, (size_t)PTEDITOR_TLB_INVALIDATION_CUSTOM));
+    /* Unlocking fails, as neither this client nor the library locked the VM */
+    ASSERT_TRUE(ioctl(fd, PTEDITOR_IOCTL_CMD_VM_UNLOCK, 0));
+    close(fd);
+    ptedit_invalidate_tlb(scratch);
+}
+#endif
+
 // =========================================================================
 //                               TLB
 // =========================================================================
 
 UTEST(tlb, invalid_tlb_invalidate_method) {
-    int ret = ptedit_switch_tlb_invalidation(3);
+    int ret = ptedit_switch_tlb_invalidation(PTEDITOR_TLB_INVALIDATION_CUSTOM_CPUMASK + 1);
     ASSERT_TRUE(ret);
 }
 
@@ -482,6 +1021,126 @@ UTEST(tlb, access_time_custom_tlb_flush) {
     ASSERT_GT(flushed, normal);
 }
 
+#if defined(LINUX)
+/* The PCID and cpumask modes only target an address space if the flush names the process */
+void invalidate_tlb_pid(void* p) {
+    ptedit_invalidate_tlb_range(getpid(), p, (char*)p + 4096);
+}
+
+/* Remaps a page of a child running on another CPU, returns the content the child reads afterwards */
+char remap_other_process(int method) {
+    static PAGE_ALIGN_CHAR original[4096], replacement[4096];
+    int to_child[2], to_parent[2];
+    char value = 0, seen = 0;
+    cpu_set_t mask, parent_mask;
+    memset(original, 'A', sizeof(original));
+    memset(replacement, 'B', sizeof(replacement));
+    if (ptedit_switch_tlb_invalidation(method)) return 0;
+    if (pipe(to_child)) return 0;
+    if (pipe(to_parent)) return 0;
+    sched_getaffinity(0, sizeof(parent_mask), &parent_mask);
+    pid_t pid = fork();
+    if (pid == 0) {
+        /* Single CPU systems keep running on CPU 0 */
+        CPU_ZERO(&mask);
+        CPU_SET(1, &mask);
+        sched_setaffinity(0, sizeof(mask), &mask);
+        value = *(volatile char*)original;
+        if (write(to_parent[1], &value, 1) != 1) _exit(1);
+        if (read(to_child[0], &value, 1) != 1) _exit(1);
+        value = *(volatile char*)original;
+        if (write(to_parent[1], &value, 1) != 1) _exit(1);
+        /* Keep the mapping until the parent restored the original entry */
+        if (read(to_child[0], &value, 1) != 1) _exit(1);
+        _exit(0);
+    }
+    CPU_ZERO(&mask);
+    CPU_SET(0, &mask);
+    sched_setaffinity(0, sizeof(mask), &mask);
+
+    if (read(to_parent[0], &value, 1) == 1) {
+        ptedit_entry_t entry = ptedit_resolve(original, pid);
+        size_t pte = entry.pte;
+        entry.pte = ptedit_set_pfn(pte, ptedit_pte_get_pfn(replacement, 0));
+        entry.valid = PTEDIT_VALID_MASK_PTE;
+        ptedit_update(original, pid, &entry);
+        ptedit_invalidate_tlb_range(pid, original, original + sizeof(original));
+        if (write(to_child[1], &value, 1) == 1 && read(to_parent[0], &seen, 1) != 1) seen = 0;
+        entry.pte = pte;
+        ptedit_update(original, pid, &entry);
+        ptedit_invalidate_tlb_range(pid, original, original + sizeof(original));
+        if (write(to_child[1], &value, 1) != 1) kill(pid, SIGKILL);
+    }
+    waitpid(pid, NULL, 0);
+    close(to_child[0]);
+    close(to_child[1]);
+    close(to_parent[0]);
+    close(to_parent[1]);
+    sched_setaffinity(0, sizeof(parent_mask), &parent_mask);
+    ptedit_switch_tlb_invalidation(PTEDITOR_TLB_INVALIDATION_KERNEL);
+    return seen;
+}
+
+UTEST(tlb, access_time_pcid_tlb_flush) {
+    ASSERT_FALSE(ptedit_switch_tlb_invalidation(PTEDITOR_TLB_INVALIDATION_CUSTOM_PCID));
+    int flushed = access_time_ext(scratch, 100, invalidate_tlb_pid);
+    int normal = access_time_ext(scratch, 100, NULL);
+    ASSERT_GT(flushed, normal);
+}
+
+UTEST(tlb, pcid_flush_other_process) {
+    ASSERT_EQ(remap_other_process(PTEDITOR_TLB_INVALIDATION_CUSTOM_PCID), 'B');
+}
+
+UTEST(tlb, access_time_cpumask_tlb_flush) {
+    ASSERT_FALSE(ptedit_switch_tlb_invalidation(PTEDITOR_TLB_INVALIDATION_CUSTOM_CPUMASK));
+    int flushed = access_time_ext(scratch, 100, invalidate_tlb_pid);
+    int normal = access_time_ext(scratch, 100, NULL);
+    ASSERT_GT(flushed, normal);
+}
+
+UTEST(tlb, cpumask_flush_other_process) {
+    ASSERT_EQ(remap_other_process(PTEDITOR_TLB_INVALIDATION_CUSTOM_CPUMASK), 'B');
+}
+
+/* The custom flush has to reach the CPU (or hart) the child runs on, not only the one that updated the entry */
+UTEST(tlb, custom_flush_other_process) {
+    ASSERT_EQ(remap_other_process(PTEDITOR_TLB_INVALIDATION_CUSTOM), 'B');
+}
+#endif
+
+void invalidate_tlb_range(void* p) {
+    ptedit_invalidate_tlb_range(0, p, (char*)p + 4096);
+}
+
+UTEST(tlb, access_time_kernel_tlb_flush_range) {
+    ptedit_switch_tlb_invalidation(PTEDITOR_TLB_INVALIDATION_KERNEL);
+    int flushed = access_time_ext(scratch, 100, invalidate_tlb_range);
+    int normal = access_time_ext(scratch, 100, NULL);
+    ASSERT_GT(flushed, normal);
+}
+
+UTEST(tlb, access_time_custom_tlb_flush_range) {
+    ptedit_switch_tlb_invalidation(PTEDITOR_TLB_INVALIDATION_CUSTOM);
+    int flushed = access_time_ext(scratch, 100, invalidate_tlb_range);
+    int normal = access_time_ext(scratch, 100, NULL);
+    ASSERT_GT(flushed, normal);
+}
+
+UTEST(tlb, access_time_pcid_tlb_flush_range) {
+    ptedit_switch_tlb_invalidation(PTEDITOR_TLB_INVALIDATION_CUSTOM_PCID);
+    int flushed = access_time_ext(scratch, 100, invalidate_tlb_range);
+    int normal = access_time_ext(scratch, 100, NULL);
+    ASSERT_GT(flushed, normal);
+}
+
+UTEST(tlb, access_time_cpumask_tlb_flush_range) {
+    ptedit_switch_tlb_invalidation(PTEDITOR_TLB_INVALIDATION_CUSTOM_CPUMASK);
+    int flushed = access_time_ext(scratch, 100, invalidate_tlb_range);
+    int normal = access_time_ext(scratch, 100, NULL);
+    ASSERT_GT(flushed, normal);
+}
+
 int main(int argc, const char *const argv[]) {
     if(ptedit_init()) {
         printf("Could not initialize PTEditor, did you load the kernel module?\n");